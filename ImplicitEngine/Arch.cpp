@@ -1,13 +1,33 @@
 #include "Arch.h"
 
 #include <array>
+#include <cstdint>
+#include <cstring>
 
+#if defined(_MSC_VER)
 #include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
 Vendor Arch::vendor = InitializeVendor();
 std::string Arch::brand = InitializeBrand();
 InstructionFlags Arch::flags = InitializeInstructionFlags();
 
+// Portable cpuid, leaves the registers zeroed on targets without one
+static void CpuId(int cpui[4], int leaf, int subleaf)
+{
+#if defined(_MSC_VER)
+    __cpuidex(cpui, leaf, subleaf);
+#elif defined(__x86_64__) || defined(__i386__)
+    unsigned int regs[4];
+    __cpuid_count(leaf, subleaf, regs[EAX], regs[EBX], regs[ECX], regs[EDX]);
+    memcpy(cpui, regs, sizeof(regs));
+#else
+    memset(cpui, 0, 4 * sizeof(int));
+#endif
+}
+
 Vendor Arch::GetVendor()
 {
     return vendor;
@@ -22,7 +42,7 @@ Vendor Arch::InitializeVendor()
 {
     // Retrieve vendor string
     int cpui[4];
-    __cpuidex(cpui, 0, 0);
+    CpuId(cpui, 0, 0);
 
     std::array<char, 12> vendorStr;
     ((int*)vendorStr.data())[0] = cpui[EBX];
@@ -43,18 +63,18 @@ std::string Arch::InitializeBrand()
 {
     // Get largest valid extended ID
     int cpui[4];
-    __cpuid(cpui, INT32_MIN);
+    CpuId(cpui, INT32_MIN, 0);
     int numExtendedIDs = cpui[EAX];
 
     std::array<char, 49> brandStr;
     brandStr[48] = '\0'; // Null terminator
-    if (numExtendedIDs > INT32_MIN + 4)
+    if ((uint32_t)numExtendedIDs >= 0x80000004)
     {
-        __cpuidex(cpui, INT32_MIN + 2, 0);
+        CpuId(cpui, INT32_MIN + 2, 0);
         memcpy(&brandStr[0], cpui, 16);
-        __cpuidex(cpui, INT32_MIN + 3, 0);
+        CpuId(cpui, INT32_MIN + 3, 0);
         memcpy(&brandStr[16], cpui, 16);
-        __cpuidex(cpui, INT32_MIN + 4, 0);
+        CpuId(cpui, INT32_MIN + 4, 0);
         memcpy(&brandStr[32], cpui, 16);
 
         return std::string{ brandStr.data() };
@@ -72,13 +92,13 @@ InstructionFlags Arch::InitializeInstructionFlags()
 
     // Get largest valid ID
     int cpui[4];
-    __cpuid(cpui, 0);
+    CpuId(cpui, 0, 0);
     int numIDs = cpui[EAX];
 
     // Load flags for IDs 0x00000001
     if (numIDs >= 1)
     {
-        __cpuidex(cpui, 1, 0);
+        CpuId(cpui, 1, 0);
         ret.flags_ECX1 = cpui[ECX];
         ret.flags_EDX1 = cpui[EDX];
     }
@@ -86,19 +106,19 @@ InstructionFlags Arch::InitializeInstructionFlags()
     // Load flags for IDs 0x00000007
     if (numIDs >= 7)
     {
-        __cpuidex(cpui, 7, 0);
+        CpuId(cpui, 7, 0);
         ret.flags_EBX7 = cpui[EBX];
         ret.flags_ECX7 = cpui[ECX];
     }
 
     // Get largest valid extended ID
-    __cpuid(cpui, INT32_MIN);
+    CpuId(cpui, INT32_MIN, 0);
     int numExtendedIDs = cpui[EAX];
 
     // Load flags for IDs 0x80000001
-    if (numExtendedIDs >= 0x80000001)
+    if ((uint32_t)numExtendedIDs >= 0x80000001)
     {
-        __cpuidex(cpui, INT32_MIN + 1, 0);
+        CpuId(cpui, INT32_MIN + 1, 0);
         ret.flags_ECX81 = cpui[ECX];
         ret.flags_EDX81 = cpui[EDX];
     }
@@ -1,5 +1,14 @@
 #pragma once
 #include <bitset>
+#include <string>
+
+// Lets one function use AVX2 and FMA intrinsics in a file built without them, callers check the CPU first.
+// MSVC compiles the intrinsics anywhere.
+#if defined(_MSC_VER)
+#define TARGET_AVX2_FMA
+#else
+#define TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#endif
 
 enum Vendor { UNKNOWN = 0, INTEL = 1, AMD = 2 };
 enum Register { EAX = 0, EBX = 1, ECX = 2, EDX = 3 };
@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Bounds.h"
+
+// Shared by the benchmark tools
+
+struct CorpusEntry
+{
+	std::string name;
+	std::string funcStr; // Equations are given as f(x, y) = 0
+	Bounds bounds;
+};
+
+inline const std::vector<CorpusEntry> corpus = {
+	{ "circle", "x^2 + y^2 - 4", { -5, -5, 5, 5 } },
+	{ "small_circle", "(x - 0.3)^2 + (y + 0.2)^2 - 0.0001", { -5, -5, 5, 5 } },
+	{ "sin_cos", "sin(x) - cos(y)", { -20, -20, 20, 20 } },
+	{ "tan_xy", "tan(x * y) - 1", { -5, -5, 5, 5 } },
+	{ "polynomial_12", "x^12 - 3 * x^7 * y^5 + y^12 - 2 * x^4 * y^2 + x - 1", { -3, -3, 3, 3 } },
+	{ "rose", "(x^2 + y^2)^3 - 4 * x^2 * y^2", { -2, -2, 2, 2 } },
+	{ "thin_ring", "(x^2 + y^2 - 4)^2 - 0.00001", { -5, -5, 5, 5 } },
+	{ "thin_wave", "y - 0.002 * sin(200 * x)", { -1, -1, 1, 1 } },
+	{ "reciprocal", "1 / (x - 0.5) - y", { -5, -5, 5, 5 } },
+	{ "floor", "floor(x) - y + 0.5", { -5, -5, 5, 5 } },
+};
+
+// Lets the benchmark block until the poll thread has buffered a given number of frames
+class FrameWaiter
+{
+public:
+	void Signal()
+	{
+		std::lock_guard lock(mutex);
+		finished++;
+		cv.notify_all();
+	}
+
+	void Wait(int frames)
+	{
+		std::unique_lock lock(mutex);
+		cv.wait(lock, [&]() { return finished >= frames; });
+	}
+
+	// False if the frames weren't buffered in time
+	bool WaitFor(int frames, std::chrono::milliseconds timeout)
+	{
+		std::unique_lock lock(mutex);
+		return cv.wait_for(lock, timeout, [&]() { return finished >= frames; });
+	}
+
+protected:
+	std::mutex mutex;
+	std::condition_variable cv;
+	int finished = 0;
+};
+
+inline std::vector<std::string> SplitList(const std::string& str)
+{
+	std::vector<std::string> ret;
+	std::stringstream stream(str);
+	std::string item;
+	while (std::getline(stream, item, ','))
+		if (!item.empty()) ret.push_back(item);
+	return ret;
+}
+
+inline std::vector<int> SplitIntList(const std::string& str)
+{
+	std::vector<int> ret;
+	for (const std::string& item : SplitList(str))
+		ret.push_back(std::stoi(item));
+	return ret;
+}
+
+// Byte counts with an optional K, M or G suffix, in powers of 1024
+inline size_t ParseBytes(const std::string& str)
+{
+	size_t pos;
+	double value = std::stod(str, &pos);
+	std::string suffix = str.substr(pos);
+	int shift = (suffix == "K" || suffix == "k") ? 10 : (suffix == "M" || suffix == "m") ? 20 : (suffix == "G" || suffix == "g") ? 30 : 0;
+	return (size_t)(value * (double)((size_t)1 << shift));
+}
+
+inline int64_t Percentile(const std::vector<int64_t>& sorted, double p)
+{
+	// Nearest rank
+	size_t rank = (size_t)std::ceil(p * sorted.size());
+	return sorted[std::clamp(rank, (size_t)1, sorted.size()) - 1];
+}
+
+inline std::string JsonEscape(const std::string& str)
+{
+	std::string ret;
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\') ret += '\\';
+		ret += c;
+	}
+	return ret;
+}
\ No newline at end of file
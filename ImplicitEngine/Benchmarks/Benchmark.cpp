@@ -0,0 +1,405 @@
+// Renders a fixed corpus of equations through each renderer and reports per-stage timings as JSON.
+// Stage timings come from the engine's STAGE_ZONEs, which time stages with or without instrumentation.
+//
+// Usage: Benchmark [--renderers filtering,marching,tracing] [--equations circle,...] [--final 6,8,10,12,14]
+//                  [--filter 5] [--seeds 2048] [--threads n,...] [--reps 10] [--warmup 2]
+//                  [--marching-max-res 12] [--memory-budget 64M] [--deterministic] [--counters] [--out benchmark.json]
+//                  [--trace prefix]
+//
+// --trace writes a Chrome trace of each configuration's frames to <prefix>_<equation>_<renderer>_<settings>.json
+// --counters adds per-frame hardware counters for each stage, from perf_event_open on Linux
+// --memory-budget caps the memory each renderer holds, jobs over it drop resolution during the warmup frames
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FilteringRenderer.h"
+#include "MarchingRenderer.h"
+#include "TracingRenderer.h"
+#include "BenchCommon.h"
+#include "PerfCounters.h"
+
+static const char* stageNames[] = { "seeding", "mesh", "fill", "contour", "collect", "total" };
+static constexpr int stageNum = 6;
+
+static const char* evalStageNames[] = { "seed_placement", "newton", "refinement", "fallback", "boundary_fill", "row_fill", "tracing" };
+static_assert(std::size(evalStageNames) == (size_t)EvalStage::COUNT);
+
+struct BenchOptions
+{
+	std::vector<std::string> renderers = { "filtering", "marching", "tracing" };
+	std::vector<std::string> equations;
+	std::vector<int> finalMeshRes = { 6, 8, 10, 12, 14 };
+	std::vector<int> filterMeshRes = { 5 };
+	std::vector<int> seedNum = { 2048 };
+	std::vector<int> threadNum = { Renderer::DefaultThreadNum() };
+	int reps = 10;
+	int warmup = 2;
+	int marchingMaxRes = 12;
+	size_t memoryBudget = 0; // None if 0
+	bool deterministic = false;
+	bool counters = false;
+	std::string outPath = "benchmark.json";
+	std::string tracePrefix; // No traces if empty
+};
+
+struct BenchConfig
+{
+	std::string renderer;
+	int finalMeshRes, filterMeshRes, seedNum, threadNum;
+};
+
+struct BenchResult
+{
+	const CorpusEntry* entry;
+	BenchConfig config;
+	size_t vertNum = 0;
+	std::vector<int64_t> samples[stageNum]; // Nanoseconds per repetition
+	EvalCounts evals; // From the last frame, counts don't vary between cold frames
+	MemoryUsage memory; // From the last frame
+	bool hasCounters = false;
+	std::array<bool, (size_t)PerfCounter::COUNT> countersAvailable{};
+	CounterValues counters[stageNum]; // Summed over repetitions
+};
+
+// The stage hook is a plain function, so it reaches the benchmark's counters through these
+static PerfCounters* hookCounters = nullptr;
+static std::atomic<CounterValues*> hookStageTotals = nullptr; // Null during warmup
+static CounterValues hookStageStarts[stageNum];
+
+static void CounterStageHook(const char* name, bool start)
+{
+	CounterValues* totals = hookStageTotals;
+	if (!totals) return;
+
+	// The last stage is the frame total, which no zone reports
+	for (int si = 0; si < stageNum - 1; si++)
+	{
+		if (std::strcmp(name, stageNames[si]) != 0) continue;
+
+		CounterValues now = hookCounters->Read();
+		if (start) hookStageStarts[si] = now;
+		else totals[si] += now - hookStageStarts[si];
+		return;
+	}
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions* opts)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--deterministic")
+		{
+			opts->deterministic = true;
+			continue;
+		}
+		if (arg == "--counters")
+		{
+			opts->counters = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for " << arg << '\n';
+			return false;
+		}
+		std::string val = argv[++i];
+
+		if (arg == "--renderers") opts->renderers = SplitList(val);
+		else if (arg == "--equations") opts->equations = SplitList(val);
+		else if (arg == "--final") opts->finalMeshRes = SplitIntList(val);
+		else if (arg == "--filter") opts->filterMeshRes = SplitIntList(val);
+		else if (arg == "--seeds") opts->seedNum = SplitIntList(val);
+		else if (arg == "--threads") opts->threadNum = SplitIntList(val);
+		else if (arg == "--reps") opts->reps = std::stoi(val);
+		else if (arg == "--warmup") opts->warmup = std::stoi(val);
+		else if (arg == "--marching-max-res") opts->marchingMaxRes = std::stoi(val);
+		else if (arg == "--memory-budget") opts->memoryBudget = ParseBytes(val);
+		else if (arg == "--out") opts->outPath = val;
+		else if (arg == "--trace") opts->tracePrefix = val;
+		else
+		{
+			std::cerr << "Unknown option " << arg << '\n';
+			return false;
+		}
+	}
+	return true;
+}
+
+// Renders warmup + reps frames of one equation, recording the stage timings of the timed frames
+template <typename R>
+static void RunFrames(R& renderer, FrameWaiter& waiter, const CorpusEntry& entry, const BenchOptions& opts, BenchResult* result)
+{
+	static constexpr size_t jobID = 1;
+
+	// Counters are opened once the renderer's threads exist, so they are all counted
+	PerfCounters perf;
+	if (opts.counters)
+	{
+		result->hasCounters = perf.Open();
+		if (result->hasCounters)
+		{
+			for (size_t ci = 0; ci < (size_t)PerfCounter::COUNT; ci++)
+				result->countersAvailable[ci] = perf.Has((PerfCounter)ci);
+
+			hookCounters = &perf;
+			Instrumentation::SetStageHook(CounterStageHook);
+		}
+		else
+			std::cerr << "No hardware counters: " << perf.GetError() << '\n';
+	}
+
+	renderer.SetDeterministic(opts.deterministic);
+	renderer.SetMemoryBudget(opts.memoryBudget);
+	CounterValues frameStart = perf.Read();
+	if (opts.warmup == 0) hookStageTotals = result->counters;
+	// Frames are timed from before submission, the poll thread may start on them straight away
+	auto start = std::chrono::steady_clock::now();
+	renderer.NewJob(entry.funcStr, entry.bounds, jobID, true, [&]() { waiter.Signal(); });
+
+	int frames = 1;
+	for (int rep = 0; rep < opts.warmup + opts.reps; rep++)
+	{
+		if (rep > 0)
+		{
+			// Stages are only counted for timed frames
+			hookStageTotals = (rep >= opts.warmup) ? result->counters : nullptr;
+			frameStart = perf.Read();
+			start = std::chrono::steady_clock::now();
+			renderer.UpdateJobs();
+			frames++;
+		}
+
+		waiter.Wait(frames);
+		std::chrono::nanoseconds total = std::chrono::steady_clock::now() - start;
+		if (rep < opts.warmup) continue;
+
+		if (result->hasCounters)
+			result->counters[stageNum - 1] += perf.Read() - frameStart;
+
+		StageTimings timings = renderer.GetStageTimings(jobID).value();
+		std::chrono::nanoseconds stages[stageNum] = { timings.seeding, timings.mesh, timings.fill, timings.contour, timings.collect, total };
+		for (int si = 0; si < stageNum; si++)
+			result->samples[si].push_back(stages[si].count());
+	}
+
+	// The renderer is idle once the last frame is buffered, so the hook can be removed
+	hookStageTotals = nullptr;
+	Instrumentation::SetStageHook(nullptr);
+	hookCounters = nullptr;
+
+	result->vertNum = renderer.GetVerts(jobID).value().size() / 2;
+	result->evals = renderer.GetEvalCounts(jobID).value();
+	result->memory = renderer.GetMemoryUsage(jobID).value();
+
+	if (!opts.tracePrefix.empty())
+	{
+		const BenchConfig& config = result->config;
+		std::string path = opts.tracePrefix + '_' + entry.name + '_' + config.renderer + '_' + std::to_string(config.finalMeshRes) + '_'
+			+ std::to_string(config.filterMeshRes) + '_' + std::to_string(config.seedNum) + '_' + std::to_string(config.threadNum) + ".json";
+
+		std::ofstream out(path);
+		if (out) renderer.WriteChromeTrace(out);
+		else std::cerr << "Could not open " << path << '\n';
+	}
+}
+
+static void RunConfig(const CorpusEntry& entry, const BenchConfig& config, const BenchOptions& opts, BenchResult* result)
+{
+	FrameWaiter waiter;
+	auto refresh = []() {};
+
+	if (config.renderer == "filtering")
+	{
+		FilteringRenderer renderer(refresh, config.seedNum, config.filterMeshRes, config.finalMeshRes, config.threadNum);
+
+		// Every frame should be a cold start for the timings to be comparable
+		renderer.UseWarmStart(false);
+		renderer.AdaptSeedNum(false);
+		RunFrames(renderer, waiter, entry, opts, result);
+	}
+	else if (config.renderer == "marching")
+	{
+		MarchingRenderer renderer(refresh, config.finalMeshRes, config.threadNum);
+		RunFrames(renderer, waiter, entry, opts, result);
+	}
+	else if (config.renderer == "tracing")
+	{
+		TracingRenderer renderer(refresh, config.seedNum, config.finalMeshRes, config.threadNum);
+		RunFrames(renderer, waiter, entry, opts, result);
+	}
+}
+
+// Expands the option lists into configurations, skipping parameters a renderer doesn't use
+static std::vector<BenchConfig> BuildConfigs(const BenchOptions& opts)
+{
+	std::vector<BenchConfig> configs;
+	for (const std::string& renderer : opts.renderers)
+	{
+		bool usesFilter = renderer == "filtering";
+		bool usesSeeds = renderer != "marching";
+
+		for (int finalRes : opts.finalMeshRes)
+		{
+			if (renderer == "marching" && finalRes > opts.marchingMaxRes) continue;
+
+			for (int filterRes : usesFilter ? opts.filterMeshRes : std::vector<int>{ 0 })
+			{
+				if (usesFilter && filterRes > finalRes) continue;
+
+				for (int seedNum : usesSeeds ? opts.seedNum : std::vector<int>{ 0 })
+					for (int threadNum : opts.threadNum)
+						configs.push_back({ renderer, finalRes, filterRes, seedNum, threadNum });
+			}
+		}
+	}
+	return configs;
+}
+
+static void WriteJson(std::ostream& out, const BenchOptions& opts, const std::vector<BenchResult>& results)
+{
+	out << "{\n";
+	out << "  \"reps\": " << opts.reps << ",\n";
+	out << "  \"warmup\": " << opts.warmup << ",\n";
+	out << "  \"deterministic\": " << (opts.deterministic ? "true" : "false") << ",\n";
+	out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+	out << "  \"results\": [\n";
+
+	for (size_t ri = 0; ri < results.size(); ri++)
+	{
+		const BenchResult& res = results[ri];
+		out << "    {\n";
+		out << "      \"equation\": \"" << JsonEscape(res.entry->name) << "\",\n";
+		out << "      \"function\": \"" << JsonEscape(res.entry->funcStr) << "\",\n";
+		out << "      \"renderer\": \"" << res.config.renderer << "\",\n";
+		out << "      \"final_mesh_res\": " << res.config.finalMeshRes << ",\n";
+		out << "      \"filter_mesh_res\": " << res.config.filterMeshRes << ",\n";
+		out << "      \"seed_num\": " << res.config.seedNum << ",\n";
+		out << "      \"threads\": " << res.config.threadNum << ",\n";
+		out << "      \"vertices\": " << res.vertNum << ",\n";
+
+		out << "      \"evaluations\": { ";
+		for (size_t ei = 0; ei < (size_t)EvalStage::COUNT; ei++)
+			out << '"' << evalStageNames[ei] << "\": " << res.evals.counts[ei] << ", ";
+		out << "\"total\": " << res.evals.Total() << ", \"grid_samples\": " << res.evals.gridSamples
+			<< ", \"filtered_fraction\": " << res.evals.FilteredFraction() << " },\n";
+
+		const MemoryUsage& mem = res.memory;
+		out << "      \"memory_bytes\": { \"verts\": " << mem.verts << ", \"buffered_verts\": " << mem.bufferedVerts
+			<< ", \"functions\": " << mem.functions << ", \"seeds\": " << mem.seeds << ", \"mesh\": " << mem.mesh
+			<< ", \"warm_start\": " << mem.warmStart << ", \"transient\": " << mem.transient << ", \"held\": " << mem.Held() << " },\n";
+		out << "      \"stages\": {\n";
+
+		for (int si = 0; si < stageNum; si++)
+		{
+			std::vector<int64_t> sorted = res.samples[si];
+			std::sort(sorted.begin(), sorted.end());
+
+			double mean = 0.0;
+			for (int64_t s : sorted) mean += (double)s / sorted.size();
+
+			out << "        \"" << stageNames[si] << "\": { ";
+			if (!sorted.empty())
+			{
+				out << "\"min_ns\": " << sorted.front()
+					<< ", \"p50_ns\": " << Percentile(sorted, 0.5)
+					<< ", \"p90_ns\": " << Percentile(sorted, 0.9)
+					<< ", \"p99_ns\": " << Percentile(sorted, 0.99)
+					<< ", \"max_ns\": " << sorted.back()
+					<< ", \"mean_ns\": " << (int64_t)mean << ' ';
+			}
+			out << '}' << (si + 1 < stageNum ? "," : "") << '\n';
+		}
+
+		if (res.hasCounters)
+		{
+			// Averages per timed frame, multiplexed counters are scaled estimates
+			out << "      },\n";
+			out << "      \"counters\": {\n";
+			for (int si = 0; si < stageNum; si++)
+			{
+				const CounterValues& counters = res.counters[si];
+				out << "        \"" << stageNames[si] << "\": { ";
+				for (size_t ci = 0; ci < (size_t)PerfCounter::COUNT; ci++)
+				{
+					if (res.countersAvailable[ci])
+						out << '"' << perfCounterNames[ci] << "\": " << (int64_t)(counters.values[ci] / opts.reps) << ", ";
+				}
+
+				double cycles = counters[PerfCounter::CYCLES];
+				out << "\"ipc\": " << (cycles > 0.0 ? counters[PerfCounter::INSTRUCTIONS] / cycles : 0.0) << " }"
+					<< (si + 1 < stageNum ? "," : "") << '\n';
+			}
+		}
+
+		out << "      }\n";
+		out << "    }" << (ri + 1 < results.size() ? "," : "") << '\n';
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions opts;
+	if (!ParseOptions(argc, argv, &opts)) return 1;
+	if (opts.reps < 1)
+	{
+		std::cerr << "--reps must be at least 1\n";
+		return 1;
+	}
+
+	std::vector<const CorpusEntry*> entries;
+	for (const CorpusEntry& entry : corpus)
+	{
+		if (opts.equations.empty() || std::find(opts.equations.begin(), opts.equations.end(), entry.name) != opts.equations.end())
+			entries.push_back(&entry);
+	}
+
+	std::vector<BenchConfig> configs = BuildConfigs(opts);
+	std::vector<BenchResult> results;
+	results.reserve(entries.size() * configs.size());
+
+	for (const CorpusEntry* entry : entries)
+	{
+		for (const BenchConfig& config : configs)
+		{
+			std::cerr << entry->name << ' ' << config.renderer << " final=" << config.finalMeshRes << " filter=" << config.filterMeshRes
+				<< " seeds=" << config.seedNum << " threads=" << config.threadNum << '\n';
+
+			BenchResult& result = results.emplace_back();
+			result.entry = entry;
+			result.config = config;
+			RunConfig(*entry, config, opts, &result);
+		}
+	}
+
+	if (opts.outPath == "-")
+	{
+		WriteJson(std::cout, opts, results);
+	}
+	else
+	{
+		std::ofstream out(opts.outPath);
+		if (!out)
+		{
+			std::cerr << "Could not open " << opts.outPath << '\n';
+			return 1;
+		}
+		WriteJson(out, opts, results);
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,446 @@
+// Times the engine's hot kernels in isolation on fixed inputs, so kernel regressions show up in seconds.
+// Each kernel is run in batches sized to last about --min-time / --samples, and the median batch is
+// reported as ns per op and cycles per element. Cycles are timestamp counter ticks, which run at the
+// CPU's nominal frequency rather than its current one, or nanoseconds on CPUs without one.
+//
+// Usage: MicroBenchmark [--kernels tile_lines,...] [--equation circle] [--res 9] [--filter 5]
+//                       [--min-time 200] [--samples 7] [--out micro.json] [--baseline micro.json] [--tolerance 0.2]
+//
+// --baseline compares ns per op against a previous --out file, exiting with 1 if any kernel slowed
+// down by more than the tolerance
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+
+#include "FilteringRenderer.h"
+#include "MarchingRenderer.h"
+#include "ProximalBracketingGenerator.h"
+#include "SoftwareRasterizer.h"
+#include "Instrumentation.h"
+#include "Arch.h"
+#include "BenchCommon.h"
+
+static const char* kernelNames[] = { "tile_lines", "marching_contour_rows", "filtering_fill_buffer", "filtering_contour_rows",
+	"insert_seed", "mesh_dilate", "pbg_generate", "raster_cover_avx", "raster_cover_scalar" };
+
+struct MicroOptions
+{
+	std::vector<std::string> kernels;
+	std::string equation = "circle";
+	int res = 9;
+	int filterMeshRes = 5;
+	std::chrono::milliseconds minTime{ 200 };
+	int samples = 7;
+	std::string outPath;
+	std::string baselinePath;
+	double tolerance = 0.2;
+};
+
+struct KernelResult
+{
+	std::string name;
+	double elementsPerOp;
+	int64_t iterations; // Per sample
+	double nsPerOp, cyclesPerElement;
+};
+
+// Results are accumulated here so the compiler can't drop the kernels' work
+static volatile double sink;
+
+// Exposes the protected kernels
+class MarchingKernels : public MarchingRenderer
+{
+public:
+	using MarchingRenderer::MarchingRenderer;
+	using MarchingRenderer::GetTileLines;
+	using MarchingRenderer::FillBuffer;
+	using MarchingRenderer::ContourRows;
+};
+
+class FilteringKernels : public FilteringRenderer
+{
+public:
+	using FilteringRenderer::FilteringRenderer;
+	using FilteringRenderer::FillBuffer;
+	using FilteringRenderer::ContourRows;
+	using FilteringRenderer::InsertSeed;
+
+	// Builds the filter mesh the same way a frame does
+	void PrepareMesh(const Bounds& bounds, const std::vector<Seed>& meshSeeds)
+	{
+		mesh.Reset(filterMeshRes);
+		seedBoxes.Reset(filterMeshRes);
+		mesh.bounds = bounds;
+		seedBoxes.bounds = bounds;
+
+		for (const Seed& s : meshSeeds)
+			InsertSeed(s);
+		mesh.Dilate(seedBoxes);
+		mesh.BuildIndex();
+	}
+
+	void DilateMesh()
+	{
+		mesh.Dilate(seedBoxes);
+	}
+
+	int GetMeshDim() const
+	{
+		return mesh.dim;
+	}
+};
+
+class RasterKernels : public SoftwareRasterizer
+{
+public:
+	using SoftwareRasterizer::SoftwareRasterizer;
+	using SoftwareRasterizer::SegmentParams;
+	using SoftwareRasterizer::CoverRowAVX;
+	using SoftwareRasterizer::CoverRowScalar;
+};
+
+template <typename F>
+static KernelResult Measure(const std::string& name, double elementsPerOp, const MicroOptions& opts, F op)
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Double the batch size until a batch lasts a sample's share of the time, which also warms up caches
+	std::chrono::nanoseconds sampleTime = opts.minTime / opts.samples;
+	int64_t iterations = 1;
+	while (true)
+	{
+		auto start = Clock::now();
+		for (int64_t i = 0; i < iterations; i++) op();
+		if (Clock::now() - start >= sampleTime || iterations >= ((int64_t)1 << 30)) break;
+		iterations *= 2;
+	}
+
+	std::vector<double> nsPerOp, ticksPerOp;
+	for (int s = 0; s < opts.samples; s++)
+	{
+		auto start = Clock::now();
+		uint64_t tickStart = Instrumentation::Ticks();
+		for (int64_t i = 0; i < iterations; i++) op();
+		uint64_t ticks = Instrumentation::Ticks() - tickStart;
+		std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+
+		nsPerOp.push_back(elapsed.count() / iterations);
+		ticksPerOp.push_back((double)ticks / iterations);
+	}
+
+	auto median = [](std::vector<double> vals)
+		{
+			std::sort(vals.begin(), vals.end());
+			return vals[vals.size() / 2];
+		};
+
+	return { name, elementsPerOp, iterations, median(nsPerOp), median(ticksPerOp) / elementsPerOp };
+}
+
+// Fixed pseudo-random inputs, the same on every run
+static std::vector<double> FixedValues(size_t num, double lo, double hi, uint32_t seed)
+{
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<double> dist(lo, hi);
+	std::vector<double> vals(num);
+	for (double& v : vals) v = dist(gen);
+	return vals;
+}
+
+static bool Wanted(const MicroOptions& opts, const std::string& name)
+{
+	return opts.kernels.empty() || std::find(opts.kernels.begin(), opts.kernels.end(), name) != opts.kernels.end();
+}
+
+static std::vector<KernelResult> RunKernels(const CorpusEntry& entry, const MicroOptions& opts)
+{
+	static constexpr uint32_t inputSeed = 1;
+	static constexpr int tileNum = 4096;
+	static constexpr int seedNum = 4096;
+	static constexpr int generateSeedNum = 256;
+	static constexpr int rasterW = 1024, rasterH = 64;
+
+	std::vector<KernelResult> results;
+	auto refresh = []() {};
+	const Bounds& bounds = entry.bounds;
+	size_t finalDim = Pow2(opts.res);
+
+	Function func(entry.funcStr);
+	MarchingKernels marching(refresh, opts.res, 1);
+	FilteringKernels filtering(refresh, seedNum, opts.filterMeshRes, opts.res, 1);
+
+	if (Wanted(opts, "tile_lines"))
+	{
+		// Unit squares with random corner values, about 1 in 8 have no sign change
+		std::vector<double> vals = FixedValues(tileNum * 4, -1.0, 1.0, inputSeed);
+		double xs[4] = { 0.0, 1.0, 1.0, 0.0 };
+		double ys[4] = { 1.0, 1.0, 0.0, 0.0 };
+		results.push_back(Measure("tile_lines", tileNum, opts, [&]()
+			{
+				double acc = 0.0;
+				for (int ti = 0; ti < tileNum; ti++)
+				{
+					Lines lines = marching.GetTileLines(xs, ys, vals.data() + ti * 4);
+					acc += lines.n ? lines.xs[0] : 0.0;
+				}
+				sink = acc;
+			}));
+	}
+
+	if (Wanted(opts, "marching_contour_rows"))
+	{
+		// The whole grid as one band, the way a single threaded frame contours it
+		std::vector<double> bottom, top;
+		std::vector<float> verts;
+		double xOrigin = (bounds.xmin + bounds.xmax) / 2, yOrigin = (bounds.ymin + bounds.ymax) / 2;
+		marching.FillBuffer(&bottom, 0, &bounds, finalDim, &func);
+		marching.FillBuffer(&top, finalDim, &bounds, finalDim, &func);
+		results.push_back(Measure("marching_contour_rows", (double)finalDim * finalDim, opts, [&]()
+			{
+				verts.clear();
+				marching.ContourRows(&verts, xOrigin, yOrigin, 0, finalDim, &bounds, &func, &bottom, &top);
+				sink = (double)verts.size();
+			}));
+	}
+
+	// Seeds from the real generator give the filter mesh a realistic shape
+	std::vector<Seed> meshSeeds;
+	ProximalBracketingGenerator::Generate(&meshSeeds, &func, bounds, 16, opts.filterMeshRes, seedNum, inputSeed);
+	filtering.PrepareMesh(bounds, meshSeeds);
+
+	if (Wanted(opts, "filtering_fill_buffer"))
+	{
+		// Every row of the final grid, elements are function evaluations
+		ValueBuffer buf((int64_t)finalDim + 1);
+		func.ResetEvalCounts();
+		for (uint64_t y = 0; y <= finalDim; y++)
+			filtering.FillBuffer(&buf, &func, y);
+		uint64_t evals = func.GetEvalCounts().Total();
+
+		results.push_back(Measure("filtering_fill_buffer", (double)std::max(evals, (uint64_t)1), opts, [&]()
+			{
+				for (uint64_t y = 0; y <= finalDim; y++)
+					filtering.FillBuffer(&buf, &func, y);
+				sink = buf.vals[finalDim / 2];
+			}));
+	}
+
+	if (Wanted(opts, "filtering_contour_rows"))
+	{
+		// The whole filtered grid as one band, elements are squares of the final grid
+		ValueBuffer bottom((int64_t)finalDim + 1), top((int64_t)finalDim + 1);
+		std::vector<float> verts;
+		double xOrigin = (bounds.xmin + bounds.xmax) / 2, yOrigin = (bounds.ymin + bounds.ymax) / 2;
+		filtering.FillBuffer(&bottom, &func, 0);
+		filtering.FillBuffer(&top, &func, finalDim);
+		results.push_back(Measure("filtering_contour_rows", (double)finalDim * finalDim, opts, [&]()
+			{
+				verts.clear();
+				filtering.ContourRows(&verts, xOrigin, yOrigin, &func, 0, finalDim - 1, &bottom, &top);
+				sink = (double)verts.size();
+			}));
+	}
+
+	if (Wanted(opts, "mesh_dilate"))
+	{
+		// Elements are filter mesh boxes
+		int meshDim = filtering.GetMeshDim();
+		results.push_back(Measure("mesh_dilate", (double)meshDim * meshDim, opts, [&]()
+			{
+				filtering.DilateMesh();
+			}));
+	}
+
+	if (Wanted(opts, "insert_seed"))
+	{
+		// Uniform seeds over slightly expanded bounds, so a few land just outside the mesh
+		Bounds seedBounds = bounds.Expand(BOUNDS_EXPANSION);
+		std::vector<double> xs = FixedValues(seedNum, seedBounds.xmin, seedBounds.xmax, inputSeed);
+		std::vector<double> ys = FixedValues(seedNum, seedBounds.ymin, seedBounds.ymax, inputSeed + 1);
+		std::vector<Seed> seeds(seedNum);
+		for (int si = 0; si < seedNum; si++)
+			seeds[si] = { xs[si], ys[si] };
+
+		results.push_back(Measure("insert_seed", seedNum, opts, [&]()
+			{
+				for (const Seed& s : seeds)
+					filtering.InsertSeed(s);
+			}));
+	}
+
+	if (Wanted(opts, "pbg_generate"))
+	{
+		std::vector<Seed> seeds;
+		seeds.reserve(generateSeedNum);
+		results.push_back(Measure("pbg_generate", generateSeedNum, opts, [&]()
+			{
+				seeds.clear();
+				ProximalBracketingGenerator::Generate(&seeds, &func, bounds, 16, opts.filterMeshRes, generateSeedNum, inputSeed);
+				sink = (double)seeds.size();
+			}));
+	}
+
+	if (Wanted(opts, "raster_cover_avx") || Wanted(opts, "raster_cover_scalar"))
+	{
+		// A shallow diagonal through a band of rows, the coverage RenderImage computes for each segment.
+		// Elements are pixels covered.
+		RasterKernels raster(rasterW, rasterH, bounds);
+		RasterKernels::SegmentParams seg = { 0.0f, 0.0f, (float)rasterW, (float)rasterH, 0.0f, 1.5f };
+		seg.invLen2 = 1.0f / (seg.dx * seg.dx + seg.dy * seg.dy);
+		std::vector<float> rows((size_t)rasterW * rasterH);
+
+		auto cover = [&](auto coverRow)
+			{
+				for (int y = 0; y < rasterH; y++)
+					coverRow(rows.data() + (size_t)y * rasterW, 0, rasterW, y + 0.5f, seg);
+				sink = rows[rows.size() / 2];
+			};
+
+		if (Wanted(opts, "raster_cover_avx") && Arch::HasInstructions<AVX2>() && Arch::HasInstructions<FMA>())
+			results.push_back(Measure("raster_cover_avx", (double)rasterW * rasterH, opts, [&]() { cover(RasterKernels::CoverRowAVX); }));
+
+		if (Wanted(opts, "raster_cover_scalar"))
+			results.push_back(Measure("raster_cover_scalar", (double)rasterW * rasterH, opts, [&]() { cover(RasterKernels::CoverRowScalar); }));
+	}
+
+	return results;
+}
+
+static bool ParseOptions(int argc, char** argv, MicroOptions* opts)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for " << arg << '\n';
+			return false;
+		}
+		std::string val = argv[++i];
+
+		if (arg == "--kernels") opts->kernels = SplitList(val);
+		else if (arg == "--equation") opts->equation = val;
+		else if (arg == "--res") opts->res = std::stoi(val);
+		else if (arg == "--filter") opts->filterMeshRes = std::stoi(val);
+		else if (arg == "--min-time") opts->minTime = std::chrono::milliseconds(std::stoi(val));
+		else if (arg == "--samples") opts->samples = std::stoi(val);
+		else if (arg == "--out") opts->outPath = val;
+		else if (arg == "--baseline") opts->baselinePath = val;
+		else if (arg == "--tolerance") opts->tolerance = std::stod(val);
+		else
+		{
+			std::cerr << "Unknown option " << arg << '\n';
+			return false;
+		}
+	}
+
+	for (const std::string& kernel : opts->kernels)
+	{
+		if (std::find(std::begin(kernelNames), std::end(kernelNames), kernel) == std::end(kernelNames))
+		{
+			std::cerr << "Unknown kernel " << kernel << '\n';
+			return false;
+		}
+	}
+	return true;
+}
+
+static void WriteJson(std::ostream& out, const MicroOptions& opts, const std::vector<KernelResult>& results)
+{
+	out << "{\n";
+	out << "  \"equation\": \"" << JsonEscape(opts.equation) << "\",\n";
+	out << "  \"res\": " << opts.res << ",\n";
+	out << "  \"filter_mesh_res\": " << opts.filterMeshRes << ",\n";
+	out << "  \"kernels\": [\n";
+	for (size_t ri = 0; ri < results.size(); ri++)
+	{
+		const KernelResult& res = results[ri];
+		out << "    { \"name\": \"" << res.name << "\", \"elements_per_op\": " << res.elementsPerOp << ", \"iterations\": " << res.iterations
+			<< ", \"ns_per_op\": " << res.nsPerOp << ", \"cycles_per_element\": " << res.cyclesPerElement << " }"
+			<< (ri + 1 < results.size() ? "," : "") << '\n';
+	}
+	out << "  ]\n";
+	out << "}\n";
+}
+
+// Reads ns per op back out of a file written by WriteJson, which puts one kernel on each line
+static std::map<std::string, double> ReadBaseline(std::istream& in)
+{
+	std::map<std::string, double> baseline;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		size_t namePos = line.find("\"name\": \"");
+		size_t nsPos = line.find("\"ns_per_op\": ");
+		if (namePos == std::string::npos || nsPos == std::string::npos) continue;
+
+		namePos += 9;
+		std::string name = line.substr(namePos, line.find('"', namePos) - namePos);
+		baseline[name] = std::stod(line.substr(nsPos + 13));
+	}
+	return baseline;
+}
+
+int main(int argc, char** argv)
+{
+	MicroOptions opts;
+	if (!ParseOptions(argc, argv, &opts)) return 1;
+
+	auto entryIt = std::find_if(corpus.begin(), corpus.end(), [&](const CorpusEntry& e) { return e.name == opts.equation; });
+	if (entryIt == corpus.end() || opts.samples < 1 || opts.filterMeshRes > opts.res)
+	{
+		std::cerr << "Need a corpus equation, at least one sample and --filter no higher than --res\n";
+		return 1;
+	}
+
+	std::vector<KernelResult> results = RunKernels(*entryIt, opts);
+
+	std::cout << "kernel                    elements/op        ns/op   cycles/element\n";
+	for (const KernelResult& res : results)
+	{
+		char line[128];
+		std::snprintf(line, sizeof(line), "%-24s %12.0f %12.1f %16.2f\n", res.name.c_str(), res.elementsPerOp, res.nsPerOp, res.cyclesPerElement);
+		std::cout << line;
+	}
+
+	if (!opts.outPath.empty())
+	{
+		std::ofstream out(opts.outPath);
+		if (!out)
+		{
+			std::cerr << "Could not open " << opts.outPath << '\n';
+			return 1;
+		}
+		WriteJson(out, opts, results);
+	}
+
+	if (!opts.baselinePath.empty())
+	{
+		std::ifstream in(opts.baselinePath);
+		if (!in)
+		{
+			std::cerr << "Could not open " << opts.baselinePath << '\n';
+			return 1;
+		}
+
+		std::map<std::string, double> baseline = ReadBaseline(in);
+		bool regressed = false;
+		for (const KernelResult& res : results)
+		{
+			auto it = baseline.find(res.name);
+			if (it == baseline.end() || it->second <= 0.0) continue;
+
+			double change = res.nsPerOp / it->second - 1.0;
+			if (change > opts.tolerance)
+			{
+				std::cerr << res.name << " regressed by " << (int)std::round(change * 100) << "%\n";
+				regressed = true;
+			}
+		}
+		if (regressed) return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Arch.h"
+
+CounterValues& CounterValues::operator+=(const CounterValues& other)
+{
+	for (size_t ci = 0; ci < values.size(); ci++)
+		values[ci] += other.values[ci];
+	return *this;
+}
+
+CounterValues CounterValues::operator-(const CounterValues& other) const
+{
+	CounterValues diff;
+	for (size_t ci = 0; ci < values.size(); ci++)
+		diff.values[ci] = values[ci] - other.values[ci];
+	return diff;
+}
+
+PerfCounters::~PerfCounters()
+{
+	Close();
+}
+
+bool PerfCounters::Has(PerfCounter counter) const
+{
+	return available[(size_t)counter];
+}
+
+const std::string& PerfCounters::GetError() const
+{
+	return error;
+}
+
+#ifdef __linux__
+struct CounterConfig
+{
+	PerfCounter counter;
+	uint32_t type;
+	uint64_t config;
+};
+
+static int OpenEvent(const CounterConfig& cfg, pid_t tid, int groupFd)
+{
+	perf_event_attr attr{};
+	attr.size = sizeof(attr);
+	attr.type = cfg.type;
+	attr.config = cfg.config;
+	attr.exclude_kernel = 1; // Allowed without privileges at the default paranoia level
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(SYS_perf_event_open, &attr, tid, -1, groupFd, 0);
+}
+
+static std::vector<pid_t> ProcessThreads()
+{
+	std::vector<pid_t> tids;
+	DIR* dir = opendir("/proc/self/task");
+	if (!dir) return tids;
+
+	while (dirent* entry = readdir(dir))
+	{
+		if (entry->d_name[0] != '.')
+			tids.push_back((pid_t)std::stol(entry->d_name));
+	}
+	closedir(dir);
+	return tids;
+}
+
+bool PerfCounters::Open()
+{
+	Close();
+
+	static const std::vector<CounterConfig> general = {
+		{ PerfCounter::CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PerfCounter::INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PerfCounter::L1D_MISSES, PERF_TYPE_HW_CACHE,
+			PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PerfCounter::LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PerfCounter::BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+
+	// CORE_POWER.LVL1/LVL2_TURBO_LICENSE, raw event 0x28 on Skylake server and later Intel cores
+	static const std::vector<CounterConfig> licence = {
+		{ PerfCounter::AVX_LICENSE_1, PERF_TYPE_RAW, 0x1828 },
+		{ PerfCounter::AVX_LICENSE_2, PERF_TYPE_RAW, 0x2028 },
+	};
+
+	std::vector<const std::vector<CounterConfig>*> configs = { &general };
+	if (Arch::GetVendor() == INTEL)
+		configs.push_back(&licence);
+
+	for (pid_t tid : ProcessThreads())
+	{
+		for (const auto* groupConfig : configs)
+		{
+			// Counters the CPU lacks are left out of the group, a group without a leader is dropped
+			Group group;
+			for (const CounterConfig& cfg : *groupConfig)
+			{
+				int fd = OpenEvent(cfg, tid, group.fds.empty() ? -1 : group.fds[0]);
+				if (fd < 0)
+				{
+					if (error.empty()) error = std::string("perf_event_open: ") + std::strerror(errno);
+					continue;
+				}
+
+				group.fds.push_back(fd);
+				group.counters.push_back(cfg.counter);
+				available[(size_t)cfg.counter] = true;
+			}
+
+			if (!group.fds.empty())
+				groups.push_back(std::move(group));
+		}
+	}
+
+	return !groups.empty();
+}
+
+void PerfCounters::Close()
+{
+	for (const Group& group : groups)
+	{
+		for (int fd : group.fds)
+			close(fd);
+	}
+	groups.clear();
+	available = {};
+	error.clear();
+}
+
+CounterValues PerfCounters::Read() const
+{
+	CounterValues total;
+	std::vector<uint64_t> buf;
+	for (const Group& group : groups)
+	{
+		// Group read format: count, time enabled, time running, then one value per counter
+		buf.resize(3 + group.fds.size());
+		ssize_t bytes = read(group.fds[0], buf.data(), buf.size() * sizeof(uint64_t));
+		if (bytes < (ssize_t)(3 * sizeof(uint64_t))) continue;
+
+		uint64_t enabled = buf[1], running = buf[2];
+		double scale = running ? (double)enabled / running : 0.0;
+		for (size_t ci = 0; ci < group.counters.size() && ci < buf[0]; ci++)
+			total[group.counters[ci]] += buf[3 + ci] * scale;
+	}
+	return total;
+}
+#else
+bool PerfCounters::Open()
+{
+	error = "perf_event_open is only available on Linux";
+	return false;
+}
+
+void PerfCounters::Close() {}
+
+CounterValues PerfCounters::Read() const
+{
+	return {};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <string>
+#include <vector>
+
+// Hardware counters read through Linux perf_event_open, unavailable on other platforms
+enum class PerfCounter
+{
+	CYCLES,
+	INSTRUCTIONS,
+	L1D_MISSES, // L1 data cache read misses
+	LLC_MISSES, // Last level cache misses
+	BRANCH_MISSES,
+	AVX_LICENSE_1, // Cycles at the AVX2 frequency licence, Intel only
+	AVX_LICENSE_2, // Cycles at the AVX-512 frequency licence, Intel only
+	COUNT
+};
+
+inline const char* perfCounterNames[] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses",
+	"avx_license_1_cycles", "avx_license_2_cycles" };
+
+struct CounterValues
+{
+	std::array<double, (size_t)PerfCounter::COUNT> values{};
+
+	double& operator[](PerfCounter counter) { return values[(size_t)counter]; }
+	double operator[](PerfCounter counter) const { return values[(size_t)counter]; }
+
+	CounterValues& operator+=(const CounterValues& other);
+	CounterValues operator-(const CounterValues& other) const;
+};
+
+// Counter groups opened on every thread of the process, counting user space only. Threads created
+// after Open aren't counted, so open the counters once the renderer's threads exist.
+class PerfCounters
+{
+public:
+	PerfCounters() = default;
+	~PerfCounters();
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	// Returns false if no counter could be opened, see GetError
+	bool Open();
+	void Close();
+
+	bool Has(PerfCounter counter) const;
+	const std::string& GetError() const;
+
+	// Totals over all threads since Open, scaled up where the kernel had to multiplex counters
+	CounterValues Read() const;
+
+protected:
+	struct Group
+	{
+		std::vector<int> fds; // The first is the group leader
+		std::vector<PerfCounter> counters;
+	};
+
+	std::vector<Group> groups;
+	std::array<bool, (size_t)PerfCounter::COUNT> available{};
+	std::string error;
+};
\ No newline at end of file
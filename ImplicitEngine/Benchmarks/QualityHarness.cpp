@@ -0,0 +1,520 @@
+// Measures what the filtering renderer's prefilter misses, against brute force marching squares.
+//
+// Each corpus equation is rendered by a high resolution MarchingRenderer as ground truth, and by a
+// MarchingRenderer at the test resolution to separate prefilter misses from resolution limits. The
+// FilteringRenderer is then swept over seed counts and filter mesh resolutions, and every frame is
+// scored for missed mesh boxes, Hausdorff distance and missed curve components. A quality/time
+// Pareto frontier over the whole corpus is reported alongside the per-equation results. First the
+// tracing renderer is checked to trace the circle as one closed polyline with its lanes concurrent.
+//
+// Usage: QualityHarness [--equations circle,...] [--ref-res 12] [--res 9] [--filter 3,4,5,6]
+//                       [--seeds 256,1024,4096,16384] [--threads n] [--reps 3] [--random] [--out quality.json]
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <unordered_map>
+
+#include "FilteringRenderer.h"
+#include "MarchingRenderer.h"
+#include "TracingRenderer.h"
+#include "BenchCommon.h"
+
+struct QualityOptions
+{
+	std::vector<std::string> equations;
+	int refRes = 12;
+	int res = 9;
+	std::vector<int> filterMeshRes = { 3, 4, 5, 6 };
+	std::vector<int> seedNum = { 256, 1024, 4096, 16384 };
+	int threadNum = Renderer::DefaultThreadNum();
+	int reps = 3;
+	bool deterministic = true;
+	std::string outPath = "quality.json";
+};
+
+struct Segment
+{
+	double x1, y1, x2, y2;
+};
+
+struct Quality
+{
+	double boxMissFraction = 0.0; // Boxes with lines at the test resolution that the filtered output left empty
+	double hausdorff = 0.0; // Between filtered output and the reference, world units
+	int missedComponents = 0; // Reference components the filtered output missed but same resolution marching found
+	int resolutionMisses = 0; // Reference components even same resolution marching missed
+};
+
+struct QualityResult
+{
+	const CorpusEntry* entry;
+	int filterMeshRes, seedNum;
+	int referenceComponents = 0;
+	std::vector<int64_t> times;
+	std::vector<Quality> frames;
+};
+
+static std::vector<Segment> ToSegments(const std::vector<double>& verts)
+{
+	std::vector<Segment> segs(verts.size() / 4);
+	for (size_t si = 0; si < segs.size(); si++)
+		segs[si] = { verts[si * 4], verts[si * 4 + 1], verts[si * 4 + 2], verts[si * 4 + 3] };
+	return segs;
+}
+
+static double PointSegmentDistance(double px, double py, const Segment& s)
+{
+	double dx = s.x2 - s.x1, dy = s.y2 - s.y1;
+	double lenSq = dx * dx + dy * dy;
+	double t = (lenSq > 0.0) ? std::clamp(((px - s.x1) * dx + (py - s.y1) * dy) / lenSq, 0.0, 1.0) : 0.0;
+	return std::hypot(px - (s.x1 + dx * t), py - (s.y1 + dy * t));
+}
+
+// Uniform grid of segment indices for nearest segment queries
+class SegmentGrid
+{
+public:
+	SegmentGrid(const std::vector<Segment>* segs_, const Bounds& bounds_, int dim_)
+		: segs(segs_), bounds(bounds_), dim(dim_), cells((size_t)dim_ * dim_)
+	{
+		for (int si = 0; si < (int)segs->size(); si++)
+		{
+			const Segment& s = (*segs)[si];
+			int x0 = CellX(std::min(s.x1, s.x2)), x1 = CellX(std::max(s.x1, s.x2));
+			int y0 = CellY(std::min(s.y1, s.y2)), y1 = CellY(std::max(s.y1, s.y2));
+			for (int cy = y0; cy <= y1; cy++)
+				for (int cx = x0; cx <= x1; cx++)
+					cells[(size_t)cy * dim + cx].push_back(si);
+		}
+	}
+
+	// Distance to the nearest segment, infinite if there are none
+	double Distance(double px, double py) const
+	{
+		double cellSize = std::min(bounds.w(), bounds.h()) / dim;
+		int cx = CellX(px), cy = CellY(py);
+
+		double best = std::numeric_limits<double>::infinity();
+		for (int ring = 0; ring < dim; ring++)
+		{
+			// Segments in this ring can't be nearer than the gap to it
+			if ((ring - 1) * cellSize > best) break;
+
+			for (int y = cy - ring; y <= cy + ring; y++)
+			{
+				if (y < 0 || y >= dim) continue;
+				bool edgeRow = (y == cy - ring || y == cy + ring);
+				for (int x = cx - ring; x <= cx + ring; x += (edgeRow ? 1 : 2 * ring))
+				{
+					if (x >= 0 && x < dim)
+						for (int si : cells[(size_t)y * dim + x])
+							best = std::min(best, PointSegmentDistance(px, py, (*segs)[si]));
+					if (ring == 0) break;
+				}
+			}
+		}
+		return best;
+	}
+
+protected:
+	int CellX(double x) const { return std::clamp((int)((x - bounds.xmin) / bounds.w() * dim), 0, dim - 1); }
+	int CellY(double y) const { return std::clamp((int)((y - bounds.ymin) / bounds.h() * dim), 0, dim - 1); }
+
+	const std::vector<Segment>* segs;
+	Bounds bounds;
+	int dim;
+	std::vector<std::vector<int>> cells;
+};
+
+// Labels connected components of a segment soup, joining segments whose endpoints coincide within 'tol'
+static std::vector<int> LabelComponents(const std::vector<Segment>& segs, double tol, int* componentNum)
+{
+	std::vector<int> parent(segs.size());
+	std::iota(parent.begin(), parent.end(), 0);
+	auto find = [&](int i)
+		{
+			while (parent[i] != i) i = parent[i] = parent[parent[i]];
+			return i;
+		};
+
+	// Endpoints are bucketed at 'tol', neighbouring buckets are checked so rounding can't split a join
+	std::unordered_map<uint64_t, int> buckets;
+	auto key = [](int64_t bx, int64_t by) { return ((uint64_t)bx << 32) ^ (uint64_t)(uint32_t)by; };
+	auto join = [&](double x, double y, int si)
+		{
+			int64_t bx = (int64_t)std::floor(x / tol), by = (int64_t)std::floor(y / tol);
+			for (int64_t ny = by - 1; ny <= by + 1; ny++)
+			{
+				for (int64_t nx = bx - 1; nx <= bx + 1; nx++)
+				{
+					auto it = buckets.find(key(nx, ny));
+					if (it != buckets.end()) parent[find(it->second)] = find(si);
+				}
+			}
+			buckets.emplace(key(bx, by), si);
+		};
+
+	for (int si = 0; si < (int)segs.size(); si++)
+	{
+		join(segs[si].x1, segs[si].y1, si);
+		join(segs[si].x2, segs[si].y2, si);
+	}
+
+	std::vector<int> labels(segs.size());
+	std::map<int, int> roots;
+	for (int si = 0; si < (int)segs.size(); si++)
+		labels[si] = roots.try_emplace(find(si), (int)roots.size()).first->second;
+
+	*componentNum = (int)roots.size();
+	return labels;
+}
+
+// Final grid boxes containing lines, segments never cross box edges so their midpoints pick the box
+static std::vector<bool> LineBoxes(const std::vector<Segment>& segs, const Bounds& bounds, int res)
+{
+	int dim = 1 << res;
+	std::vector<bool> boxes((size_t)dim * dim);
+	for (const Segment& s : segs)
+	{
+		int bx = std::clamp((int)(((s.x1 + s.x2) / 2 - bounds.xmin) / bounds.w() * dim), 0, dim - 1);
+		int by = std::clamp((int)(((s.y1 + s.y2) / 2 - bounds.ymin) / bounds.h() * dim), 0, dim - 1);
+		boxes[(size_t)by * dim + bx] = true;
+	}
+	return boxes;
+}
+
+// Everything about the reference an output gets compared against
+struct Reference
+{
+	std::vector<Segment> segs;
+	std::vector<int> labels;
+	int componentNum = 0;
+	std::vector<bool> foundBySameRes; // Per component
+	std::vector<bool> sameResBoxes;
+	size_t sameResBoxNum = 0;
+	double cellSize = 0.0; // Test resolution cell
+};
+
+// Components count as found if any of their points come within this many test cells of the output
+static constexpr double componentTolCells = 1.5;
+
+static std::vector<bool> FoundComponents(const Reference& ref, const SegmentGrid& outGrid)
+{
+	std::vector<bool> found(ref.componentNum, false);
+	for (size_t si = 0; si < ref.segs.size(); si++)
+	{
+		const Segment& s = ref.segs[si];
+		if (!found[ref.labels[si]] && outGrid.Distance((s.x1 + s.x2) / 2, (s.y1 + s.y2) / 2) <= componentTolCells * ref.cellSize)
+			found[ref.labels[si]] = true;
+	}
+	return found;
+}
+
+static Quality Score(const Reference& ref, const std::vector<Segment>& out, const Bounds& bounds, int res)
+{
+	Quality q;
+	int gridDim = 1 << std::min(res, 9);
+
+	// Box coverage against same resolution marching, which evaluates every box
+	std::vector<bool> outBoxes = LineBoxes(out, bounds, res);
+	size_t missedBoxes = 0;
+	for (size_t bi = 0; bi < outBoxes.size(); bi++)
+		missedBoxes += ref.sameResBoxes[bi] && !outBoxes[bi];
+	q.boxMissFraction = ref.sameResBoxNum ? (double)missedBoxes / ref.sameResBoxNum : 0.0;
+
+	// Hausdorff distance, sampling segment endpoints and midpoints of each side against the other
+	SegmentGrid outGrid(&out, bounds, gridDim);
+	SegmentGrid refGrid(&ref.segs, bounds, gridDim);
+	auto directed = [](const std::vector<Segment>& from, const SegmentGrid& to)
+		{
+			double worst = 0.0;
+			for (const Segment& s : from)
+			{
+				worst = std::max(worst, to.Distance(s.x1, s.y1));
+				worst = std::max(worst, to.Distance(s.x2, s.y2));
+				worst = std::max(worst, to.Distance((s.x1 + s.x2) / 2, (s.y1 + s.y2) / 2));
+			}
+			return worst;
+		};
+	q.hausdorff = std::max(directed(out, refGrid), directed(ref.segs, outGrid));
+
+	std::vector<bool> found = FoundComponents(ref, outGrid);
+	for (int ci = 0; ci < ref.componentNum; ci++)
+	{
+		if (found[ci]) continue;
+		if (ref.foundBySameRes[ci]) q.missedComponents++;
+		else q.resolutionMisses++;
+	}
+
+	return q;
+}
+
+// Renders reps frames, calling frameFun with the output and wall time of each
+// The waiter must outlive the renderer, the poll thread signals it
+template <typename R, typename F>
+static void RenderFrames(R& renderer, FrameWaiter& waiter, const CorpusEntry& entry, int reps, bool deterministic, F frameFun)
+{
+	static constexpr size_t jobID = 1;
+
+	renderer.SetDeterministic(deterministic);
+	auto start = std::chrono::steady_clock::now();
+	renderer.NewJob(entry.funcStr, entry.bounds, jobID, true, [&]() { waiter.Signal(); });
+
+	for (int rep = 0; rep < reps; rep++)
+	{
+		if (rep > 0)
+		{
+			start = std::chrono::steady_clock::now();
+			renderer.UpdateJobs();
+		}
+
+		waiter.Wait(rep + 1);
+		std::chrono::nanoseconds time = std::chrono::steady_clock::now() - start;
+		frameFun(renderer.GetVerts(jobID).value(), time);
+	}
+}
+
+static Reference BuildReference(const CorpusEntry& entry, const QualityOptions& opts)
+{
+	Reference ref;
+	ref.cellSize = std::min(entry.bounds.w(), entry.bounds.h()) / (1 << opts.res);
+	auto refresh = []() {};
+
+	{
+		FrameWaiter waiter;
+		MarchingRenderer marching(refresh, opts.refRes, opts.threadNum);
+		RenderFrames(marching, waiter, entry, 1, true, [&](const std::vector<double>& verts, std::chrono::nanoseconds)
+			{
+				ref.segs = ToSegments(verts);
+			});
+	}
+
+	double refCell = std::min(entry.bounds.w(), entry.bounds.h()) / (1 << opts.refRes);
+	ref.labels = LabelComponents(ref.segs, refCell * 1e-6, &ref.componentNum);
+
+	FrameWaiter waiter;
+	MarchingRenderer marching(refresh, opts.res, opts.threadNum);
+	RenderFrames(marching, waiter, entry, 1, true, [&](const std::vector<double>& verts, std::chrono::nanoseconds)
+		{
+			std::vector<Segment> sameRes = ToSegments(verts);
+			ref.sameResBoxes = LineBoxes(sameRes, entry.bounds, opts.res);
+			ref.sameResBoxNum = std::count(ref.sameResBoxes.begin(), ref.sameResBoxes.end(), true);
+
+			SegmentGrid sameResGrid(&sameRes, entry.bounds, 1 << std::min(opts.res, 9));
+			ref.foundBySameRes = FoundComponents(ref, sameResGrid);
+		});
+
+	return ref;
+}
+
+// Concurrent tracing lanes race for coverage, a duplicate trace would show as a second component
+static bool CheckTracedCircle(const QualityOptions& opts)
+{
+	const CorpusEntry& entry = *std::find_if(corpus.begin(), corpus.end(), [](const CorpusEntry& e) { return e.name == "circle"; });
+	double cellSize = std::min(entry.bounds.w(), entry.bounds.h()) / (1 << opts.res);
+	bool ok = true;
+
+	FrameWaiter waiter;
+	TracingRenderer tracing([]() {}, 2048, opts.res, opts.threadNum);
+	RenderFrames(tracing, waiter, entry, opts.reps, false, [&](const std::vector<double>& verts, std::chrono::nanoseconds)
+		{
+			std::vector<Segment> segs = ToSegments(verts);
+			int componentNum = 0;
+			LabelComponents(segs, cellSize * 1e-6, &componentNum);
+
+			// Polylines share their joins exactly, so a closed one has every endpoint twice
+			std::map<std::pair<double, double>, int> ends;
+			for (const Segment& s : segs)
+			{
+				ends[{ s.x1, s.y1 }]++;
+				ends[{ s.x2, s.y2 }]++;
+			}
+			bool closed = std::all_of(ends.begin(), ends.end(), [](const auto& end) { return end.second == 2; });
+
+			if (componentNum != 1 || !closed)
+			{
+				std::cerr << "Tracing check failed: circle gave " << componentNum << " polylines" << (closed ? "" : ", not all closed") << '\n';
+				ok = false;
+			}
+		});
+	return ok;
+}
+
+static bool ParseOptions(int argc, char** argv, QualityOptions* opts)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--random")
+		{
+			opts->deterministic = false;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for " << arg << '\n';
+			return false;
+		}
+		std::string val = argv[++i];
+
+		if (arg == "--equations") opts->equations = SplitList(val);
+		else if (arg == "--ref-res") opts->refRes = std::stoi(val);
+		else if (arg == "--res") opts->res = std::stoi(val);
+		else if (arg == "--filter") opts->filterMeshRes = SplitIntList(val);
+		else if (arg == "--seeds") opts->seedNum = SplitIntList(val);
+		else if (arg == "--threads") opts->threadNum = std::stoi(val);
+		else if (arg == "--reps") opts->reps = std::stoi(val);
+		else if (arg == "--out") opts->outPath = val;
+		else
+		{
+			std::cerr << "Unknown option " << arg << '\n';
+			return false;
+		}
+	}
+	return true;
+}
+
+// JSON has no infinity, an output with no lines at all has no finite distance
+static std::string JsonNumber(double val)
+{
+	return std::isfinite(val) ? std::to_string(val) : "null";
+}
+
+static void WriteJson(std::ostream& out, const QualityOptions& opts, const std::vector<QualityResult>& results)
+{
+	out << "{\n";
+	out << "  \"reference_res\": " << opts.refRes << ",\n";
+	out << "  \"res\": " << opts.res << ",\n";
+	out << "  \"reps\": " << opts.reps << ",\n";
+	out << "  \"deterministic\": " << (opts.deterministic ? "true" : "false") << ",\n";
+	out << "  \"results\": [\n";
+
+	// Corpus totals per configuration for the frontier
+	struct Aggregate { int64_t time = 0; double boxMiss = 0.0, hausdorffCells = 0.0; int missedComponents = 0; int equations = 0; };
+	std::map<std::pair<int, int>, Aggregate> aggregates;
+
+	for (size_t ri = 0; ri < results.size(); ri++)
+	{
+		const QualityResult& res = results[ri];
+		double cellSize = std::min(res.entry->bounds.w(), res.entry->bounds.h()) / (1 << opts.res);
+
+		std::vector<int64_t> sorted = res.times;
+		std::sort(sorted.begin(), sorted.end());
+		int64_t timeP50 = Percentile(sorted, 0.5);
+
+		Quality mean, worst;
+		for (const Quality& q : res.frames)
+		{
+			mean.boxMissFraction += q.boxMissFraction / res.frames.size();
+			mean.hausdorff += q.hausdorff / res.frames.size();
+			worst.hausdorff = std::max(worst.hausdorff, q.hausdorff);
+			worst.missedComponents = std::max(worst.missedComponents, q.missedComponents);
+			worst.resolutionMisses = std::max(worst.resolutionMisses, q.resolutionMisses);
+		}
+
+		Aggregate& agg = aggregates[{ res.filterMeshRes, res.seedNum }];
+		agg.time += timeP50;
+		agg.boxMiss += mean.boxMissFraction;
+		agg.hausdorffCells = std::max(agg.hausdorffCells, worst.hausdorff / cellSize);
+		agg.missedComponents += worst.missedComponents;
+		agg.equations++;
+
+		out << "    { \"equation\": \"" << JsonEscape(res.entry->name) << "\", \"filter_mesh_res\": " << res.filterMeshRes
+			<< ", \"seed_num\": " << res.seedNum << ", \"time_p50_ns\": " << timeP50
+			<< ", \"box_miss_fraction\": " << mean.boxMissFraction
+			<< ", \"hausdorff\": " << JsonNumber(mean.hausdorff) << ", \"hausdorff_max_cells\": " << JsonNumber(worst.hausdorff / cellSize)
+			<< ", \"missed_components\": " << worst.missedComponents << ", \"resolution_misses\": " << worst.resolutionMisses
+			<< ", \"reference_components\": " << res.referenceComponents << " }" << (ri + 1 < results.size() ? "," : "") << '\n';
+	}
+	out << "  ],\n";
+
+	// A configuration is on the frontier if no other is at least as fast and as accurate, and better in one
+	std::vector<std::pair<std::pair<int, int>, Aggregate>> frontier;
+	for (const auto& [config, agg] : aggregates)
+	{
+		bool dominated = false;
+		for (const auto& [other, otherAgg] : aggregates)
+		{
+			bool noWorse = otherAgg.time <= agg.time && otherAgg.boxMiss <= agg.boxMiss && otherAgg.missedComponents <= agg.missedComponents;
+			bool better = otherAgg.time < agg.time || otherAgg.boxMiss < agg.boxMiss || otherAgg.missedComponents < agg.missedComponents;
+			if (noWorse && better) dominated = true;
+		}
+		if (!dominated) frontier.push_back({ config, agg });
+	}
+	std::sort(frontier.begin(), frontier.end(), [](const auto& a, const auto& b) { return a.second.time < b.second.time; });
+
+	out << "  \"pareto\": [\n";
+	for (size_t fi = 0; fi < frontier.size(); fi++)
+	{
+		const auto& [config, agg] = frontier[fi];
+		out << "    { \"filter_mesh_res\": " << config.first << ", \"seed_num\": " << config.second
+			<< ", \"corpus_time_ns\": " << agg.time << ", \"mean_box_miss_fraction\": " << agg.boxMiss / agg.equations
+			<< ", \"max_hausdorff_cells\": " << JsonNumber(agg.hausdorffCells) << ", \"missed_components\": " << agg.missedComponents
+			<< " }" << (fi + 1 < frontier.size() ? "," : "") << '\n';
+	}
+	out << "  ]\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv)
+{
+	QualityOptions opts;
+	if (!ParseOptions(argc, argv, &opts)) return 1;
+	if (opts.reps < 1 || opts.res > opts.refRes)
+	{
+		std::cerr << "Need at least one rep and --res no higher than --ref-res\n";
+		return 1;
+	}
+	if (!CheckTracedCircle(opts)) return 1;
+
+	std::vector<QualityResult> results;
+	for (const CorpusEntry& entry : corpus)
+	{
+		if (!opts.equations.empty() && std::find(opts.equations.begin(), opts.equations.end(), entry.name) == opts.equations.end())
+			continue;
+
+		std::cerr << entry.name << ": reference\n";
+		Reference ref = BuildReference(entry, opts);
+
+		for (int filterRes : opts.filterMeshRes)
+		{
+			if (filterRes > opts.res) continue;
+
+			for (int seedNum : opts.seedNum)
+			{
+				std::cerr << entry.name << ": filter=" << filterRes << " seeds=" << seedNum << '\n';
+
+				QualityResult& result = results.emplace_back();
+				result.entry = &entry;
+				result.filterMeshRes = filterRes;
+				result.seedNum = seedNum;
+				result.referenceComponents = ref.componentNum;
+
+				FrameWaiter waiter;
+				FilteringRenderer renderer([]() {}, seedNum, filterRes, opts.res, opts.threadNum);
+
+				// Every frame should be a cold start, the same as in the benchmark
+				renderer.UseWarmStart(false);
+				renderer.AdaptSeedNum(false);
+				RenderFrames(renderer, waiter, entry, opts.reps, opts.deterministic, [&](const std::vector<double>& verts, std::chrono::nanoseconds time)
+					{
+						result.times.push_back(time.count());
+						result.frames.push_back(Score(ref, ToSegments(verts), entry.bounds, opts.res));
+					});
+			}
+		}
+	}
+
+	std::ofstream out(opts.outPath);
+	if (!out)
+	{
+		std::cerr << "Could not open " << opts.outPath << '\n';
+		return 1;
+	}
+	WriteJson(out, opts, results);
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+// Renders equations straight to a PNG or PPM image, for machines without a GPU or display.
+//
+// Equations are given as f(x, y) = 0, either directly with --eq (repeatable) or by corpus name. The
+// FilteringRenderer output is drawn by the SoftwareRasterizer over optional gridlines and axes.
+//
+// Usage: RenderImage [--eq "x^2 + y^2 - 4"]... [--corpus circle,...] [--bounds -5,-5,5,5]
+//                    [--size 1024x1024] [--line-width 2] [--res 9] [--filter 5] [--seeds 2048]
+//                    [--threads n] [--memory-budget 64M] [--no-grid] [--out plot.png]
+#include <iostream>
+
+#include "FilteringRenderer.h"
+#include "SoftwareRasterizer.h"
+#include "BenchCommon.h"
+
+struct RenderOptions
+{
+	std::vector<std::string> equations;
+	std::optional<Bounds> bounds;
+	int width = 1024, height = 1024;
+	float lineWidth = 2.0f;
+	int res = 9;
+	int filterMeshRes = 5;
+	int seedNum = 2048;
+	int threadNum = Renderer::DefaultThreadNum();
+	size_t memoryBudget = 0; // None if 0
+	bool grid = true;
+	std::string outPath = "plot.png";
+};
+
+// Equations are coloured from this in turn
+static constexpr RGBA palette[] = { { 200, 40, 40, 255 }, { 40, 90, 200, 255 }, { 30, 150, 60, 255 },
+	{ 150, 60, 180, 255 }, { 230, 130, 20, 255 }, { 0, 0, 0, 255 } };
+
+static bool ParseOptions(int argc, char** argv, RenderOptions* opts)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--no-grid")
+		{
+			opts->grid = false;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for " << arg << '\n';
+			return false;
+		}
+		std::string val = argv[++i];
+
+		if (arg == "--eq") opts->equations.push_back(val);
+		else if (arg == "--corpus")
+		{
+			for (const std::string& name : SplitList(val))
+			{
+				auto entry = std::find_if(corpus.begin(), corpus.end(), [&](const CorpusEntry& e) { return e.name == name; });
+				if (entry == corpus.end())
+				{
+					std::cerr << "Unknown corpus equation " << name << '\n';
+					return false;
+				}
+
+				opts->equations.push_back(entry->funcStr);
+				if (!opts->bounds) opts->bounds = entry->bounds;
+			}
+		}
+		else if (arg == "--bounds")
+		{
+			std::vector<std::string> vals = SplitList(val);
+			if (vals.size() != 4)
+			{
+				std::cerr << "--bounds takes xmin,ymin,xmax,ymax\n";
+				return false;
+			}
+			opts->bounds = Bounds(std::stod(vals[0]), std::stod(vals[1]), std::stod(vals[2]), std::stod(vals[3]));
+		}
+		else if (arg == "--size")
+		{
+			size_t sep = val.find('x');
+			if (sep == std::string::npos)
+			{
+				std::cerr << "--size takes WIDTHxHEIGHT\n";
+				return false;
+			}
+			opts->width = std::stoi(val.substr(0, sep));
+			opts->height = std::stoi(val.substr(sep + 1));
+		}
+		else if (arg == "--line-width") opts->lineWidth = std::stof(val);
+		else if (arg == "--res") opts->res = std::stoi(val);
+		else if (arg == "--filter") opts->filterMeshRes = std::stoi(val);
+		else if (arg == "--seeds") opts->seedNum = std::stoi(val);
+		else if (arg == "--threads") opts->threadNum = std::stoi(val);
+		else if (arg == "--memory-budget") opts->memoryBudget = ParseBytes(val);
+		else if (arg == "--out") opts->outPath = val;
+		else
+		{
+			std::cerr << "Unknown option " << arg << '\n';
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	RenderOptions opts;
+	if (!ParseOptions(argc, argv, &opts)) return 1;
+	if (opts.equations.empty() || opts.width < 1 || opts.height < 1)
+	{
+		std::cerr << "Need at least one equation and a positive image size\n";
+		return 1;
+	}
+	Bounds bounds = opts.bounds.value_or(Bounds(-5, -5, 5, 5));
+
+	FrameWaiter waiter;
+	FilteringRenderer renderer([]() {}, opts.seedNum, opts.filterMeshRes, opts.res, opts.threadNum);
+	renderer.SetDeterministic(true);
+	renderer.SetMemoryBudget(opts.memoryBudget);
+
+	// Every valid job buffers exactly one frame
+	std::vector<size_t> ids;
+	for (size_t ei = 0; ei < opts.equations.size(); ei++)
+	{
+		if (renderer.NewJob(opts.equations[ei], bounds, ei, true, [&]() { waiter.Signal(); }))
+			ids.push_back(ei);
+		else
+			std::cerr << "Skipping invalid equation " << opts.equations[ei] << '\n';
+	}
+	waiter.Wait((int)ids.size());
+
+	// Over the budget jobs re-render a level lower each frame, wait for them to fit or stop degrading
+	static constexpr std::chrono::milliseconds settleTimeout{ 1000 };
+	int frames = (int)ids.size();
+	while (opts.memoryBudget && renderer.GetHeldMemory() > opts.memoryBudget && waiter.WaitFor(frames + 1, settleTimeout))
+		frames++;
+
+	SoftwareRasterizer raster(opts.width, opts.height, bounds);
+	raster.Clear({ 255, 255, 255, 255 });
+	if (opts.grid)
+	{
+		raster.DrawGrid({ 0, 0, 0, 77 });
+		raster.DrawAxes(2.0f, { 0, 0, 0, 255 });
+	}
+
+	for (size_t id : ids)
+		raster.DrawLines(renderer.GetVerts(id).value(), opts.lineWidth, palette[id % std::size(palette)]);
+
+	if (!raster.Write(opts.outPath))
+	{
+		std::cerr << "Could not write " << opts.outPath << '\n';
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -6,10 +6,11 @@ wxBEGIN_EVENT_TABLE(Canvas, wxPanel)
 	EVT_SIZE(Canvas::Resized)
     EVT_MOUSEWHEEL(Canvas::OnScroll)
     EVT_MOTION(Canvas::OnMouseMove)
+    EVT_TIMER(Canvas::paceTimerID, Canvas::OnPaceTimer)
 wxEND_EVENT_TABLE()
 
 Canvas::Canvas(wxWindow* parent, const wxGLAttributes& attribs)
-    : wxGLCanvas(parent, attribs)
+    : wxGLCanvas(parent, attribs), paceTimer(this, paceTimerID)
 {
 	SetBackgroundStyle(wxBG_STYLE_CUSTOM);
 	mainPtr = (Main*)parent;
@@ -45,13 +46,17 @@ Canvas::Canvas(wxWindow* parent, const wxGLAttributes& attribs)
     shader = Shader::CompileString(
 #include "basicshader"
     );
+    contourShader = Shader::CompileString(
+#include "contourshader"
+    );
+    contours = new ContourBatch;
 
     va = new VertexArray;
-    vb = new VertexBuffer;
+    stream = new StreamBuffer(streamRegionSize);
     vbl = new VertexBufferLayout;
 
     vbl->Push<float>(2);
-    va->AddVBuffer(*vb, *vbl);
+    va->AddVBuffer(*stream, *vbl);
 
     // Initialize text renderer
     textRenderer = new TextRenderer;
@@ -65,14 +70,20 @@ Canvas::Canvas(wxWindow* parent, const wxGLAttributes& attribs)
 
 Canvas::~Canvas()
 {
+    // Stop the poll thread first so it can't request a repaint of a half destroyed canvas
+    delete renderer;
+
+    grid.geom.reset();
+    seedOverlays.clear();
+    meshOverlays.clear();
+    delete contours;
+    delete stream;
     delete context;
-    delete vb;
     delete vbl;
     delete va;
     delete shader;
+    delete contourShader;
     delete textRenderer;
-
-    delete renderer;
 }
 
 void Canvas::ResetView()
@@ -85,8 +96,40 @@ void Canvas::ResetView()
 
 void Canvas::JobProcessingFinished()
 {
-    Update();
-    Refresh();
+    RequestRepaint();
+}
+
+void Canvas::RequestRepaint()
+{
+    // Only the first request since the last paint posts to the UI thread, the rest are answered by the same paint
+    if (!repaintPending.exchange(true))
+        CallAfter([this]() { SchedulePaint(); });
+}
+
+void Canvas::SchedulePaint()
+{
+    // A paint since the request already drew the newest vertices
+    if (!repaintPending) return;
+
+    // Querying the display is slow, so like displaySize it's only redone after a resize
+    if (refreshInterval.count() == 0)
+    {
+        wxDisplay display((unsigned int)wxDisplay::GetFromWindow(this));
+        int refreshRate = display.GetCurrentMode().refresh;
+        refreshInterval = std::chrono::nanoseconds(1'000'000'000 / (refreshRate > 0 ? refreshRate : 60));
+    }
+
+    // Paint now if a refresh interval has passed since the last present, otherwise once it has
+    auto sinceLast = std::chrono::steady_clock::now() - lastPresent;
+    if (sinceLast >= refreshInterval)
+        Refresh(false);
+    else if (!paceTimer.IsRunning())
+        paceTimer.StartOnce((int)std::chrono::ceil<std::chrono::milliseconds>(refreshInterval - sinceLast).count());
+}
+
+void Canvas::OnPaceTimer(wxTimerEvent&)
+{
+    Refresh(false);
 }
 
 void Canvas::DisplayStandard(bool display)
@@ -107,31 +150,76 @@ void Canvas::DisplayMeshes(bool display)
     renderer->KeepMesh(display);
 }
 
+void Canvas::SetJobColour(size_t id, wxColour col)
+{
+    jobColours[id] = col;
+    RequestRepaint();
+}
+
+wxColour Canvas::GetJobColour(size_t id)
+{
+    auto it = jobColours.find(id);
+    return (it != jobColours.end()) ? it->second : wxColour(0, 0, 0);
+}
+
+const LatencyHistogram& Canvas::GetInputLatency(InputSource source)
+{
+    return inputLatency[(size_t)source];
+}
+
+const LatencyHistogram& Canvas::GetInputLatency()
+{
+    return inputLatency[(size_t)InputSource::COUNT];
+}
+
+void Canvas::ResetInputLatency()
+{
+    for (LatencyHistogram& histogram : inputLatency)
+        histogram.Reset();
+}
+
 void Canvas::OnDraw()
 {
     glViewport(0, 0, w, h);
 
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
+    stream->BeginFrame();
 
     // === Drawing code ===
     // Determine Grid Spacing
     auto [mantissa, exponent] = DetermineGridSpacing();
     double gridW = pow(10, exponent) * mantissa;
 
+    // Overlays not cached in world space are built in screen space
+    SetVertexTransform(1.0, 1.0, 0.0, 0.0);
+
     // Gridlines
-    DrawGridlines(gridW, 0.3f); // Major
-    DrawGridlines(gridW / 5, 0.1f); // Minor
+    DrawGrid(gridW);
 
     // Equations
+    std::vector<InputStamp> presentedInput;
+    std::vector<size_t> jobIDs;
+    double xScale = relXScale / w;
+    double yScale = relYScale / h;
+
     for (std::shared_ptr<Job> job : renderer->jobs)
     {
+        jobIDs.push_back(job->id);
+
+        // Debug overlays are rebuilt when the job has new results
+        uint64_t frame;
+        {
+            std::lock_guard lock(job->bufferMutex);
+            frame = job->bufferedFrame;
+        }
+
         if (displaySeeds)
         {
             // Draw seeds
             auto seeds = renderer->GetSeeds(job->id);
             if (seeds.has_value())
-                DrawSeeds(seeds.value());
+                DrawSeeds(job->id, frame, seeds.value());
         }
 
         if (displayMeshes)
@@ -139,20 +227,49 @@ void Canvas::OnDraw()
             // Draw filtering meshes
             auto mesh = renderer->GetMesh(job->id);
             if (mesh.has_value())
-                DrawMesh(mesh.value());
+                DrawMesh(job->id, frame, mesh.value());
         }
 
         if (displayStandard)
         {
-            // Draw final contour
-
-            std::lock_guard lock(job->bufferMutex);
-            DrawContour(job->bufferedVerts, job->col);
+            // Queue final contour, only uploading vertices the GPU hasn't seen
+            std::unique_lock lock(job->bufferMutex);
+            if (!contours->IsCurrent(job->id, job->bufferedFrame))
+            {
+                ZONE(contour_upload, &renderer->events, job->id);
+                const std::vector<float>& verts = job->bufferedVerts;
+                size_t offset = verts.empty() ? 0 : StreamWrite(verts.data(), verts.size() * sizeof(float), 2 * sizeof(float));
+                contours->Upload(job->id, job->bufferedFrame, verts.size() / 2, *stream, offset, job->bufferedXOrigin, job->bufferedYOrigin);
+            }
+            if (job->bufferedInput.ticks)
+                presentedInput.push_back(std::exchange(job->bufferedInput, {}));
+            lock.unlock();
+
+            wxColour col = GetJobColour(job->id);
+            float colf[4] = { col.Red() / 255.0f, col.Green() / 255.0f, col.Blue() / 255.0f, 1.0f };
+            contours->AddDraw(job->id, colf, xScale, yScale, xOffset, yOffset);
         }
     }
 
+    // Drop overlays of deleted jobs, and all of them once hidden
+    auto retain = [&](std::map<size_t, std::unique_ptr<WorldGeometry>>& overlays, bool display)
+        {
+            std::erase_if(overlays, [&](const auto& entry) { return !display || std::find(jobIDs.begin(), jobIDs.end(), entry.first) == jobIDs.end(); });
+        };
+    retain(seedOverlays, displaySeeds);
+    retain(meshOverlays, displayMeshes);
+
+    // Final contours of every job in one draw
+    contours->Retain(jobIDs);
+    contourShader->Bind();
+    glUniform2f(contourShader->GetUniformLocation("scale"), (float)xScale, (float)yScale);
+    contours->Draw();
+    shader->Bind();
+    va->Bind();
+
     // Axes
     DrawAxes(2.0f);
+    stream->EndFrame();
 
     // Axes text
     DrawAxisText({ mantissa, exponent });
@@ -160,10 +277,23 @@ void Canvas::OnDraw()
     va->Bind();
 
     SwapBuffers();
+    lastPresent = std::chrono::steady_clock::now();
+
+    // Input is answered once the swap is queued, the compositor's delay on top of that isn't visible here
+    uint64_t presented = Instrumentation::Ticks();
+    for (const InputStamp& input : presentedInput)
+    {
+        std::chrono::nanoseconds latency = Instrumentation::ToDuration(presented - input.ticks);
+        inputLatency[(size_t)input.source].Record(latency);
+        inputLatency[(size_t)InputSource::COUNT].Record(latency);
+    }
 }
 
 void Canvas::OnPaint(wxPaintEvent& evt)
 {
+    // Cleared before drawing, so vertices buffered mid-draw request another paint
+    repaintPending = false;
+    paceTimer.Stop();
     RecalculateBounds();
 
     OnDraw();
@@ -179,6 +309,8 @@ void Canvas::Resized(wxSizeEvent& evt)
         xOffset *= (double)w / newW;
         yOffset *= (double)h / newH;
     }
+    displaySize = 0; // May have moved to another display
+    refreshInterval = std::chrono::nanoseconds(0);
     UpdateJobs();
     
 	evt.Skip();
@@ -186,6 +318,8 @@ void Canvas::Resized(wxSizeEvent& evt)
 
 void Canvas::OnScroll(wxMouseEvent& evt)
 {
+    InputStamp input = { Instrumentation::Ticks(), InputSource::SCROLL };
+
     // Zoom
     double factor = 1.5;
     if (evt.GetWheelRotation() < 0) { factor = 1.0 / factor; }
@@ -199,8 +333,8 @@ void Canvas::OnScroll(wxMouseEvent& evt)
     relXScale *= factor;
     relYScale *= factor;
 
-    UpdateJobs();
-    Refresh();
+    UpdateJobs(input);
+    RequestRepaint();
     evt.Skip();
 }
 
@@ -224,11 +358,13 @@ void Canvas::OnMouseMove(wxMouseEvent& evt)
 
 void Canvas::OnMouseDrag(double delX, double delY)
 {
+    InputStamp input = { Instrumentation::Ticks(), InputSource::DRAG };
+
     xOffset -= delX / w * 2;
     yOffset += delY / h * 2;
 
-    UpdateJobs();
-    Refresh();
+    UpdateJobs(input);
+    RequestRepaint();
 }
 
 void Canvas::ToScreen(float& xout, float& yout, double x, double y)
@@ -252,54 +388,84 @@ void Canvas::DrawAxes(float width)
     std::array<Point, 12> axisBuf = { p[0], p[1], p[2], p[1], p[2], p[3],
         p[4], p[5], p[6], p[5], p[6], p[7] };
 
-    vb->SetData(axisBuf.data(), axisBuf.size() * sizeof(Point));
-
     glUniform4f(shader->GetUniformLocation("col"), 0.0f, 0.0f, 0.0f, 1.0f);
-    glDrawArrays(GL_TRIANGLES, 0, 12);
+    DrawStreamed(GL_TRIANGLES, axisBuf.data(), axisBuf.size());
 }
 
-void Canvas::DrawGridlines(double spacing, float opacity)
+void Canvas::DrawGrid(double spacing)
 {
-    std::vector<Point> linesBuf;
-
-    // Horizontal lines
-    double startY = ceil(bounds.ymin / spacing) * spacing;
-    int num = (int)floor(bounds.h() / spacing);
-
-    for (int yi = 0; yi <= num; yi++)
-    {
-        double worldY = startY + spacing * yi;
-        float screenY = (float)(worldY * relYScale / h - yOffset);
-
-        linesBuf.push_back({ -1, screenY });
-        linesBuf.push_back({ 1, screenY });
-    }
+    // Rebuild once the spacing changes or the view leaves the area the lines were built for
+    bool inside = bounds.xmin >= grid.covered.xmin && bounds.xmax <= grid.covered.xmax
+        && bounds.ymin >= grid.covered.ymin && bounds.ymax <= grid.covered.ymax;
+    if (!grid.geom || grid.spacing != spacing || !inside)
+        BuildGrid(spacing);
+
+    glUniform4f(shader->GetUniformLocation("col"), 0.0f, 0.0f, 0.0f, 0.3f);
+    DrawWorld(*grid.geom, GL_LINES, 0, grid.majorNum); // Major
+    glUniform4f(shader->GetUniformLocation("col"), 0.0f, 0.0f, 0.0f, 0.1f);
+    DrawWorld(*grid.geom, GL_LINES, grid.majorNum, grid.geom->vertNum - grid.majorNum); // Minor
+}
 
-    // Vertical lines
-    double startX = ceil(bounds.xmin / spacing) * spacing;
-    num = (int)floor(bounds.w() / spacing);
+void Canvas::BuildGrid(double spacing)
+{
+    // A view's width of margin on every side, so panning rarely needs a rebuild
+    static constexpr double coverage = 3.0;
 
-    for (int xi = 0; xi <= num; xi++)
+    if (!grid.geom)
     {
-        double worldX = startX + spacing * xi;
-        float screenX = (float)(worldX * relXScale / w - xOffset);
-
-        linesBuf.push_back({ screenX, -1 });
-        linesBuf.push_back({ screenX, 1 });
+        grid.geom = std::make_unique<WorldGeometry>();
+        grid.geom->va.AddVBuffer(grid.geom->vb, *vbl);
+        va->Bind();
     }
 
-    vb->SetData(linesBuf.data(), linesBuf.size() * sizeof(Point));
+    grid.spacing = spacing;
+    grid.covered = bounds.Expand(coverage);
+    const Bounds& covered = grid.covered;
+    double xOrigin = (covered.xmin + covered.xmax) / 2;
+    double yOrigin = (covered.ymin + covered.ymax) / 2;
 
-    glUniform4f(shader->GetUniformLocation("col"), 0.0f, 0.0f, 0.0f, opacity);
-    glDrawArrays(GL_LINES, 0, (int)linesBuf.size());
+    std::vector<Point> linesBuf;
+    auto addLines = [&](double step)
+        {
+            // Horizontal lines
+            double startY = ceil(covered.ymin / step) * step;
+            int num = (int)floor(covered.h() / step);
+            for (int yi = 0; yi <= num; yi++)
+            {
+                float y = (float)(startY + step * yi - yOrigin);
+                linesBuf.push_back({ (float)(covered.xmin - xOrigin), y });
+                linesBuf.push_back({ (float)(covered.xmax - xOrigin), y });
+            }
+
+            // Vertical lines
+            double startX = ceil(covered.xmin / step) * step;
+            num = (int)floor(covered.w() / step);
+            for (int xi = 0; xi <= num; xi++)
+            {
+                float x = (float)(startX + step * xi - xOrigin);
+                linesBuf.push_back({ x, (float)(covered.ymin - yOrigin) });
+                linesBuf.push_back({ x, (float)(covered.ymax - yOrigin) });
+            }
+        };
+
+    addLines(spacing);
+    grid.majorNum = linesBuf.size();
+    addLines(spacing / 5);
+
+    UploadWorld(grid.geom.get(), linesBuf, xOrigin, yOrigin);
 }
 
 std::pair<int, int> Canvas::DetermineGridSpacing()
 {
-    wxDisplay display((unsigned int)wxDisplay::GetFromWindow(this));
-    wxRect screen = display.GetClientArea();
+    // Querying the display is slow, so it's only redone after a resize
+    if (!displaySize)
+    {
+        wxDisplay display((unsigned int)wxDisplay::GetFromWindow(this));
+        wxRect screen = display.GetClientArea();
+        displaySize = std::max(screen.width, screen.height);
+    }
 
-    double targetMajorSize = std::max(screen.width, screen.height) / 15.0;
+    double targetMajorSize = displaySize / 15.0;
 
     // Find grid width that achieves target
     double exactGridW = targetMajorSize / w * bounds.w();
@@ -341,7 +507,7 @@ void Canvas::DrawAxisText(std::pair<int, int> spacingSF)
         double worldY = startY + spacing * yi;
         screenY = (float)((worldY * relYScale / h - yOffset + 1.0) / 2.0 * h);
 
-        textRenderer->RenderText(std::format("{:.10}", worldY), { "Arial", 48 }, w, h, screenX, screenY, 0.5f);
+        textRenderer->QueueText(std::format("{:.10}", worldY), { "Arial", 48 }, w, h, screenX, screenY, 0.5f);
     }
 
     // x-axis text
@@ -356,131 +522,148 @@ void Canvas::DrawAxisText(std::pair<int, int> spacingSF)
         if ((int)ceil(bounds.xmin / spacing) + xi == 0) continue;
         screenX = (float)((worldX * relXScale / w - xOffset + 1.0) / 2.0 * w);
 
-        textRenderer->RenderText(std::format("{:.10}", worldX), { "Arial", 48 }, w, h, screenX, screenY, 0.5f);
+        textRenderer->QueueText(std::format("{:.10}", worldX), { "Arial", 48 }, w, h, screenX, screenY, 0.5f);
     }
+
+    // Every label in one draw
+    textRenderer->DrawQueued();
 }
 
-void Canvas::DrawSeeds(const std::shared_ptr<Seeds>& seeds)
+void Canvas::DrawSeeds(size_t id, uint64_t frame, const std::shared_ptr<Seeds>& seeds)
 {
-    std::vector<float> screenSeeds;
-    
-    // Count seeds
-    size_t num = 0;
-    for (const auto& seedVec : *seeds)
-        num += seedVec.size();
+    std::unique_ptr<WorldGeometry>& geom = seedOverlays[id];
+    if (!geom || geom->frame != frame)
+    {
+        ZONE(seed_overlay, &renderer->events, id);
+        if (!geom)
+        {
+            geom = std::make_unique<WorldGeometry>();
+            geom->va.AddVBuffer(geom->vb, *vbl);
+            va->Bind();
+        }
 
-    screenSeeds.reserve(num * 2);
+        // Count seeds
+        size_t num = 0;
+        for (const auto& seedVec : *seeds)
+            num += seedVec.size();
 
-    // Transform seeds to screen coordinates
-    double xScale = relXScale / w;
-    double yScale = relYScale / h;
-    for (const auto& seedVec : *seeds)
-    {
-        for (const Seed& s : seedVec)
+        std::vector<Point> points;
+        points.reserve(num);
+
+        // Seeds relative to the first one
+        double xOrigin = 0.0, yOrigin = 0.0;
+        for (const auto& seedVec : *seeds)
         {
-            screenSeeds.push_back((float)(s.x * xScale - xOffset));
-            screenSeeds.push_back((float)(s.y * yScale - yOffset));
+            for (const Seed& s : seedVec)
+            {
+                if (points.empty()) { xOrigin = s.x; yOrigin = s.y; }
+                points.push_back({ (float)(s.x - xOrigin), (float)(s.y - yOrigin) });
+            }
         }
+
+        UploadWorld(geom.get(), points, xOrigin, yOrigin);
+        geom->frame = frame;
     }
 
     glUniform4f(shader->GetUniformLocation("col"), 0.0f, 0.0f, 0.0f, 1.0f);
-    vb->SetData(screenSeeds.data(), screenSeeds.size() * sizeof(float));
-    glDrawArrays(GL_POINTS, 0, (int)num);
+    DrawWorld(*geom, GL_POINTS, 0, geom->vertNum);
 }
 
-void Canvas::DrawMesh(const std::shared_ptr<Mesh>& mesh)
+void Canvas::DrawMesh(size_t id, uint64_t frame, const std::shared_ptr<Mesh>& mesh)
 {
-    int dim = mesh->dim;
-    std::vector<Point> verts;
-
-    double boxW = mesh->bounds.w() / dim;
-    double boxH = mesh->bounds.h() / dim;
-
-    for (int by = 0; by < dim; by++)
+    std::unique_ptr<WorldGeometry>& geom = meshOverlays[id];
+    if (!geom || geom->frame != frame)
     {
-        for (int bx = 0; bx < dim; bx++)
+        ZONE(mesh_overlay, &renderer->events, id);
+        if (!geom)
         {
-            if (!(*mesh).boxes[bx + by * dim]) continue;
-
-            double x1 = mesh->bounds.xmin + boxW * bx;
-            double x2 = x1 + boxW;
-
-            double y1 = mesh->bounds.ymin + boxH * by;
-            double y2 = y1 + boxH;
+            geom = std::make_unique<WorldGeometry>();
+            geom->va.AddVBuffer(geom->vb, *vbl);
+            va->Bind();
+        }
 
-            // Transform point to screen coordinates
-            float x1s, y1s, x2s, y2s;
-            ToScreen(x1s, y1s, x1, y1);
-            ToScreen(x2s, y2s, x2, y2);
+        int dim = mesh->dim;
+        std::vector<Point> verts;
 
-            Point corners[4] = { { x1s, y1s }, { x1s, y2s }, { x2s, y2s }, { x2s, y1s } };
+        // Boxes relative to the mesh's corner, in box units scaled back to world once
+        double boxW = mesh->bounds.w() / dim;
+        double boxH = mesh->bounds.h() / dim;
 
-            verts.push_back(corners[0]);
-            verts.push_back(corners[1]);
-            verts.push_back(corners[2]);
-            verts.push_back(corners[2]);
-            verts.push_back(corners[3]);
-            verts.push_back(corners[0]);
+        // One quad per run of active boxes in a row rather than one per box
+        for (int by = 0; by < dim; by++)
+        {
+            for (const Span& span : mesh->RowSpans(by))
+            {
+                float x1 = (float)(boxW * span.start);
+                float x2 = (float)(boxW * span.end);
+
+                float y1 = (float)(boxH * by);
+                float y2 = (float)(boxH * (by + 1));
+
+                Point corners[4] = { { x1, y1 }, { x1, y2 }, { x2, y2 }, { x2, y1 } };
+
+                verts.push_back(corners[0]);
+                verts.push_back(corners[1]);
+                verts.push_back(corners[2]);
+                verts.push_back(corners[2]);
+                verts.push_back(corners[3]);
+                verts.push_back(corners[0]);
+            }
         }
+
+        UploadWorld(geom.get(), verts, mesh->bounds.xmin, mesh->bounds.ymin);
+        geom->frame = frame;
     }
 
     glUniform4f(shader->GetUniformLocation("col"), 1.0f, 0.0f, 0.0f, 0.2f);
-    vb->SetData(verts.data(), verts.size() * sizeof(Point));
-    glDrawArrays(GL_TRIANGLES, 0, (int)verts.size());
+    DrawWorld(*geom, GL_TRIANGLES, 0, geom->vertNum);
 }
 
-void Canvas::DrawContour(const std::vector<double>& verts, const wxColour& col)
+void Canvas::UploadWorld(WorldGeometry* geom, const std::vector<Point>& points, double xOrigin, double yOrigin)
 {
-    if (verts.size() == 0) return;
+    geom->vertNum = points.size();
+    geom->xOrigin = xOrigin;
+    geom->yOrigin = yOrigin;
+    if (points.size() > 0)
+        geom->vb.SetData((void*)points.data(), points.size() * sizeof(Point));
+}
 
-    if (Arch::HasInstructions<AVX>())
-    {
-        TIMER(transform);
-        double xScale = relXScale / w;
-        double yScale = relYScale / h;
-        __m256d mulPack = _mm256_setr_pd(xScale, yScale, xScale, yScale);
-        __m256d subPack = _mm256_setr_pd(xOffset, yOffset, xOffset, yOffset);
-
-        float* screenVerts = new float[verts.size()];
-        for (size_t packIdx = 0; packIdx < verts.size() / 4; packIdx++)
-        {
-            __m256d pack = _mm256_loadu_pd(verts.data() + packIdx * 4);
-            __m128 transformed = _mm256_cvtpd_ps(_mm256_fmsub_pd(pack, mulPack, subPack));
-            _mm_storeu_ps(screenVerts + packIdx * 4, transformed);
-        }
+void Canvas::DrawWorld(const WorldGeometry& geom, GLenum mode, size_t first, size_t count)
+{
+    if (count == 0) return;
 
-        // Finish remaining values serially
-        for (uint64_t i = (verts.size() / 4) * 4; i < verts.size(); i++)
-        {
-            if (i % 2 == 0) screenVerts[i] = (float)(verts[i] * xScale - xOffset);
-            else screenVerts[i] = (float)(verts[i + 1] * yScale - yOffset);
-        }
-        STOP_LOG(transform);
+    double xScale = relXScale / w;
+    double yScale = relYScale / h;
+    SetVertexTransform(xScale, yScale, ScreenTransform::FoldOrigin(geom.xOrigin, xScale, xOffset), ScreenTransform::FoldOrigin(geom.yOrigin, yScale, yOffset));
 
-        vb->SetData(screenVerts, verts.size() * sizeof(float));
-        glUniform4f(shader->GetUniformLocation("col"), col.Red() / 255.0f, col.Green() / 255.0f, col.Blue() / 255.0f, 1.0f);
-        glDrawArrays(GL_LINES, 0, (int)verts.size() / 2);
-        delete[] screenVerts;
-    }
-    else
-    {
-        TIMER(transform);
-        std::vector<float> screenVerts;
-        screenVerts.reserve(verts.size());
+    geom.va.Bind();
+    glDrawArrays(mode, (int)first, (int)count);
 
-        double xScale = relXScale / w;
-        double yScale = relYScale / h;
-        for (int i = 0; i < verts.size(); i += 2)
-        {
-            screenVerts.push_back((float)(verts[i] * xScale - xOffset));
-            screenVerts.push_back((float)(verts[i + 1] * yScale - yOffset));
-        }
-        STOP_LOG(transform);
+    // Back to the screen space stream for the rest of the overlays
+    SetVertexTransform(1.0, 1.0, 0.0, 0.0);
+    va->Bind();
+}
 
-        vb->SetData(screenVerts.data(), screenVerts.size() * sizeof(float));
-        glUniform4f(shader->GetUniformLocation("col"), col.Red() / 255.0f, col.Green() / 255.0f, col.Blue() / 255.0f, 1.0f);
-        glDrawArrays(GL_LINES, 0, (int)screenVerts.size() / 2);
-    }
+void Canvas::SetVertexTransform(double xScale, double yScale, double xOff, double yOff)
+{
+    glUniform2f(shader->GetUniformLocation("scale"), (float)xScale, (float)yScale);
+    glUniform2f(shader->GetUniformLocation("offset"), (float)xOff, (float)yOff);
+}
+
+void Canvas::DrawStreamed(GLenum mode, const void* points, size_t pointNum)
+{
+    if (pointNum == 0) return;
+
+    size_t offset = StreamWrite(points, pointNum * sizeof(Point), sizeof(Point));
+    glDrawArrays(mode, (int)(offset / sizeof(Point)), (int)pointNum);
+}
+
+size_t Canvas::StreamWrite(const void* data, size_t size, size_t alignment)
+{
+    bool reallocated = false;
+    size_t offset = stream->Write(data, size, alignment, &reallocated);
+    if (reallocated) va->AddVBuffer(*stream, *vbl);
+    return offset;
 }
 
 void Canvas::RecalculateBounds()
@@ -493,11 +676,11 @@ void Canvas::RecalculateBounds()
         (double)h / relYScale * (yOffset + 1) };
 }
 
-void Canvas::UpdateJobs()
+void Canvas::UpdateJobs(InputStamp input)
 {
     RecalculateBounds();
     for (std::shared_ptr<Job> job : renderer->jobs)
         job->bounds = bounds;
 
-    renderer->UpdateJobs();
+    renderer->UpdateJobs(input);
 }
\ No newline at end of file
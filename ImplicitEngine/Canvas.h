@@ -15,20 +15,25 @@
 #include <array>
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <format>
+#include <map>
+#include <memory>
 
 // OpenGL includes
 #include "VertexBuffer.h"
 #include "VertexBufferLayout.h"
 #include "VertexArray.h"
+#include "StreamBuffer.h"
+#include "ContourBatch.h"
 #include "Shader.h"
 #include "TextRenderer.h"
 
 // Custom header files
 #include "FilteringRenderer.h"
 #include "MarchingRenderer.h"
-#include "Timer.h"
 #include "Arch.h"
+#include "ScreenTransform.h"
 
 typedef FilteringRenderer RendererType;
 
@@ -42,6 +47,25 @@ struct MousePosition
 
 struct Point { float x, y; };
 
+// Overlay vertices cached on the GPU as floats relative to a world space origin, so they're drawn
+// through the shader's view transform and survive panning and zooming without being rebuilt
+struct WorldGeometry
+{
+	VertexBuffer vb;
+	VertexArray va;
+	size_t vertNum = 0;
+	double xOrigin = 0.0, yOrigin = 0.0;
+	uint64_t frame = 0; // Job::bufferedFrame the geometry was built for, for job overlays
+};
+
+struct GridCache
+{
+	std::unique_ptr<WorldGeometry> geom;
+	double spacing = 0.0; // Major spacing, minor lines are a fifth of it
+	Bounds covered; // World area the lines span, a margin around the view they were built for
+	size_t majorNum = 0; // Major line vertices come first, then the minor ones
+};
+
 class Canvas : public wxGLCanvas
 {
 public:
@@ -53,19 +77,34 @@ public:
 
 	void JobProcessingFinished();
 
+	// Safe from any thread. Marks the canvas dirty, it's painted on the UI thread at most once per display refresh.
+	void RequestRepaint();
+
 	void DisplayStandard(bool display);
 	void DisplaySeeds(bool display);
 	void DisplayMeshes(bool display);
 
+	// Equation colours are kept here, the renderer knows nothing about presentation
+	void SetJobColour(size_t id, wxColour col);
+	wxColour GetJobColour(size_t id);
+
+	// Time from a scroll, drag or equation edit until the vertices answering it are presented
+	const LatencyHistogram& GetInputLatency(InputSource source);
+	const LatencyHistogram& GetInputLatency(); // All sources
+	void ResetInputLatency();
+
 protected:
 	int w = 0, h = 0;
 
 	// OpenGL wrappers
 	wxGLContext* context;
-	VertexBuffer* vb;
+	StreamBuffer* stream; // Overlay geometry rebuilt every frame, and staging for contour uploads
+	static constexpr size_t streamRegionSize = 1 << 20; // Grows if a frame's writes need more
 	VertexBufferLayout* vbl;
 	VertexArray* va;
 	Shader* shader;
+	Shader* contourShader;
+	ContourBatch* contours; // Every job's line vertices, drawn in one call
 	
 	TextRenderer* textRenderer;
 
@@ -74,6 +113,22 @@ protected:
 	bool displayStandard = true;
 	bool displaySeeds = false;
 	bool displayMeshes = false;
+	std::map<size_t, wxColour> jobColours;
+
+	// Overlay geometry, only rebuilt when the grid spacing, the area it covers or a job's results change
+	GridCache grid;
+	std::map<size_t, std::unique_ptr<WorldGeometry>> seedOverlays, meshOverlays;
+	int displaySize = 0; // Largest dimension of the display the canvas is on, for grid spacing
+
+	// Frame pacing, requests made before a paint starts are all answered by it
+	static constexpr int paceTimerID = 40001;
+	std::atomic<bool> repaintPending = false;
+	wxTimer paceTimer;
+	std::chrono::steady_clock::time_point lastPresent;
+	std::chrono::nanoseconds refreshInterval{ 0 }; // Of the display the canvas is on, 0 until queried
+
+	// Indexed by InputSource, the last entry covers every source
+	std::array<LatencyHistogram, (size_t)InputSource::COUNT + 1> inputLatency;
 
 	// Coordinate system
 	double relXScale = 300.0, relYScale = 300.0;
@@ -84,6 +139,8 @@ protected:
 
 	void OnDraw();
 	void OnPaint(wxPaintEvent& evt);
+	void OnPaceTimer(wxTimerEvent& evt);
+	void SchedulePaint();
 	void Resized(wxSizeEvent& evt);
 	void OnScroll(wxMouseEvent& evt);
 	void OnMouseMove(wxMouseEvent& evt);
@@ -91,16 +148,21 @@ protected:
 	void ToScreen(float& xout, float& yout, double x, double y);
 
 	void DrawAxes(float width);
-	void DrawGridlines(double spacing, float opacity);
+	void DrawGrid(double spacing);
+	void BuildGrid(double spacing);
 	std::pair<int, int> DetermineGridSpacing();
 	std::pair<int, int> RoundMajorGridValue(double val);
 	void DrawAxisText(std::pair<int, int> spacingSF);
-	void DrawSeeds(const std::shared_ptr<Seeds>& seeds);
-	void DrawMesh(const std::shared_ptr<Mesh>& mesh);
-	void DrawContour(const std::vector<double>& verts, const wxColour& col);
+	void DrawSeeds(size_t id, uint64_t frame, const std::shared_ptr<Seeds>& seeds);
+	void DrawMesh(size_t id, uint64_t frame, const std::shared_ptr<Mesh>& mesh);
+	void UploadWorld(WorldGeometry* geom, const std::vector<Point>& points, double xOrigin, double yOrigin);
+	void DrawWorld(const WorldGeometry& geom, GLenum mode, size_t first, size_t count);
+	void SetVertexTransform(double xScale, double yScale, double xOff, double yOff);
+	void DrawStreamed(GLenum mode, const void* points, size_t pointNum);
+	size_t StreamWrite(const void* data, size_t size, size_t alignment);
 
 	void RecalculateBounds();
-	void UpdateJobs();
+	void UpdateJobs(InputStamp input = {});
 
 	friend Main;
 	wxDECLARE_EVENT_TABLE();
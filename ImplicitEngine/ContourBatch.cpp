@@ -0,0 +1,144 @@
+#include "ContourBatch.h"
+#include "ScreenTransform.h"
+
+#include <algorithm>
+
+ContourBatch::ContourBatch()
+{
+	GlCall(glGenBuffers(1, &drawDataID));
+	GlCall(glGenVertexArrays(1, &arrayID));
+	Repack(SIZE_MAX, 0);
+}
+
+ContourBatch::~ContourBatch()
+{
+	glDeleteBuffers(1, &vertexID);
+	glDeleteBuffers(1, &drawDataID);
+	glDeleteVertexArrays(1, &arrayID);
+}
+
+bool ContourBatch::IsCurrent(size_t id, uint64_t frame) const
+{
+	auto it = ranges.find(id);
+	return it != ranges.end() && it->second.frame == frame;
+}
+
+void ContourBatch::Upload(size_t id, uint64_t frame, size_t count, const StreamBuffer& staging, size_t offset, double xOrigin, double yOrigin)
+{
+	if (count > ranges[id].capacity) Reserve(id, count);
+
+	Range& range = ranges[id];
+	range.frame = frame;
+	range.count = count;
+	if (count == 0) return;
+
+	range.xOrigin = xOrigin;
+	range.yOrigin = yOrigin;
+
+	staging.Bind(GL_COPY_READ_BUFFER);
+	GlCall(glBindBuffer(GL_COPY_WRITE_BUFFER, vertexID));
+	GlCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, range.first * vertexSize, count * vertexSize));
+}
+
+void ContourBatch::Retain(const std::vector<size_t>& ids)
+{
+	std::erase_if(ranges, [&](const auto& entry) { return std::find(ids.begin(), ids.end(), entry.first) == ids.end(); });
+}
+
+void ContourBatch::AddDraw(size_t id, const float col[4], double xScale, double yScale, double xOffset, double yOffset)
+{
+	auto it = ranges.find(id);
+	if (it == ranges.end() || it->second.count == 0) return;
+	const Range& range = it->second;
+
+	DrawData draw = { { col[0], col[1], col[2], col[3] },
+		{ (float)ScreenTransform::FoldOrigin(range.xOrigin, xScale, xOffset), (float)ScreenTransform::FoldOrigin(range.yOrigin, yScale, yOffset) }, {} };
+
+	firsts.push_back((GLint)range.first);
+	counts.push_back((GLsizei)range.count);
+	drawData.push_back(draw);
+}
+
+void ContourBatch::Draw()
+{
+	if (drawData.size() > 0)
+	{
+		GlCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataID));
+		GlCall(glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), drawData.data(), GL_STREAM_DRAW));
+		GlCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawDataID));
+
+		GlCall(glBindVertexArray(arrayID));
+		GlCall(glMultiDrawArrays(GL_LINES, firsts.data(), counts.data(), (GLsizei)drawData.size()));
+	}
+
+	firsts.clear();
+	counts.clear();
+	drawData.clear();
+}
+
+void ContourBatch::Reserve(size_t id, size_t count)
+{
+	// Slack so a slightly longer curve next frame still fits in place
+	size_t capacity = count + count / 2;
+	if (vertEnd + capacity > vertCapacity)
+	{
+		Repack(id, capacity);
+		return;
+	}
+
+	// The old slot becomes a hole until the next repack
+	Range& range = ranges[id];
+	range.first = vertEnd;
+	range.capacity = capacity;
+	vertEnd += capacity;
+}
+
+void ContourBatch::Repack(size_t growID, size_t growCapacity)
+{
+	size_t liveCapacity = growCapacity;
+	for (const auto& [id, range] : ranges)
+		if (id != growID) liveCapacity += range.capacity;
+
+	// Double what's live so holes and growth don't force another repack soon
+	size_t newCapacity = std::max(2 * liveCapacity, minCapacity);
+	unsigned int newID = 0;
+	GlCall(glGenBuffers(1, &newID));
+	GlCall(glBindBuffer(GL_COPY_WRITE_BUFFER, newID));
+	GlCall(glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * vertexSize, nullptr, GL_DYNAMIC_DRAW));
+
+	// Move live ranges across on the GPU, the growing job is re-uploaded by the caller
+	size_t end = 0;
+	if (vertexID)
+	{
+		GlCall(glBindBuffer(GL_COPY_READ_BUFFER, vertexID));
+	}
+	for (auto& [id, range] : ranges)
+	{
+		if (id == growID)
+		{
+			range.capacity = growCapacity;
+			range.count = 0;
+		}
+		else if (range.count > 0)
+		{
+			GlCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.first * vertexSize, end * vertexSize, range.count * vertexSize));
+		}
+
+		range.first = end;
+		end += range.capacity;
+	}
+
+	if (vertexID) glDeleteBuffers(1, &vertexID);
+	vertexID = newID;
+	vertCapacity = newCapacity;
+	vertEnd = end;
+
+	// Point the attribute at the new buffer, leaving the caller's vertex array bound
+	GLint boundArray = 0;
+	GlCall(glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &boundArray));
+	GlCall(glBindVertexArray(arrayID));
+	GlCall(glBindBuffer(GL_ARRAY_BUFFER, vertexID));
+	GlCall(glEnableVertexAttribArray(0));
+	GlCall(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, (int)vertexSize, nullptr));
+	GlCall(glBindVertexArray(boundArray));
+}
\ No newline at end of file
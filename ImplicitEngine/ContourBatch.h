@@ -0,0 +1,63 @@
+#pragma once
+#include "glall.h"
+#include "StreamBuffer.h"
+
+#include <vector>
+#include <map>
+#include <cstdint>
+
+// Line vertices of every job packed into one buffer and drawn with a single glMultiDrawArrays. Each
+// job has a range with some slack so new results usually update in place, and ranges are repacked on
+// the GPU when one outgrows its slot. Vertices are floats relative to a per-job double origin. The view
+// scale is a uniform as in the basic shader, colour and origin-folded offset come per draw from a
+// storage buffer indexed by gl_DrawID.
+class ContourBatch
+{
+public:
+	ContourBatch();
+	~ContourBatch();
+
+	// Whether the job's vertices as of frame are already uploaded
+	bool IsCurrent(size_t id, uint64_t frame) const;
+	// Copies count vertices written to staging at offset into the job's range. They're x, y float pairs
+	// relative to the origin, as renderers produce them. The copy runs on the GPU, so unlike glBufferSubData
+	// it never waits for draws still reading the batch.
+	void Upload(size_t id, uint64_t frame, size_t count, const StreamBuffer& staging, size_t offset, double xOrigin, double yOrigin);
+	// Drops the ranges of jobs that aren't in ids
+	void Retain(const std::vector<size_t>& ids);
+
+	// Queues a job for the next Draw, screen = world * scale - offset
+	void AddDraw(size_t id, const float col[4], double xScale, double yScale, double xOffset, double yOffset);
+	// Draws everything queued as lines, with the contour shader bound and its scale set to the view's
+	void Draw();
+
+private:
+	struct Range
+	{
+		size_t first = 0, count = 0, capacity = 0; // In vertices
+		uint64_t frame = 0;
+		double xOrigin = 0.0, yOrigin = 0.0;
+	};
+
+	// Matches DrawData in contour.shader under std430 layout, padded to its 16 byte aligned stride
+	struct DrawData
+	{
+		float col[4];
+		float offset[2];
+		float padding[2];
+	};
+
+	static constexpr size_t vertexSize = 2 * sizeof(float);
+	static constexpr size_t minCapacity = 1 << 16;
+
+	unsigned int vertexID = 0, arrayID = 0, drawDataID = 0;
+	size_t vertCapacity = 0, vertEnd = 0;
+	std::map<size_t, Range> ranges;
+
+	std::vector<GLint> firsts;
+	std::vector<GLsizei> counts;
+	std::vector<DrawData> drawData;
+
+	void Reserve(size_t id, size_t count);
+	void Repack(size_t growID, size_t growCapacity);
+};
\ No newline at end of file
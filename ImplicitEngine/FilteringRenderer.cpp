@@ -1,8 +1,8 @@
 #include "FilteringRenderer.h"
 
-FilteringRenderer::FilteringRenderer(CallbackFun refreshFun, int seedNum_, int filterMeshRes_, int finalMeshRes_)
-	: Renderer(refreshFun), pool(std::thread::hardware_concurrency() - 1), seedNum(seedNum_), filterMeshRes(filterMeshRes_),
-		finalMeshRes(finalMeshRes_), seeds(pool.get_thread_count()), mesh(filterMeshRes) {}
+FilteringRenderer::FilteringRenderer(CallbackFun refreshFun, int seedNum_, int filterMeshRes_, int finalMeshRes_, int threadNum)
+	: Renderer(refreshFun), pool(threadNum), seedNum(seedNum_), filterMeshRes(filterMeshRes_),
+		finalMeshRes(finalMeshRes_), frameMeshRes(finalMeshRes_), seeds(pool.get_thread_count()), mesh(filterMeshRes), seedBoxes(filterMeshRes) {}
 
 FilteringRenderer::~FilteringRenderer()
 {
@@ -45,19 +45,45 @@ void FilteringRenderer::SetFinalMeshRes(int value)
 void FilteringRenderer::KeepSeeds(bool keep)
 {
 	keepSeeds = keep;
-	if (!keepSeeds) jobSeeds.clear();
+	if (!keepSeeds)
+	{
+		std::lock_guard lock(displayMutex);
+		jobSeeds.clear();
+	}
 	UpdateJobs();
 }
 
 void FilteringRenderer::KeepMesh(bool keep)
 {
 	keepMesh = keep;
-	if (!keepMesh) jobMeshes.clear();
+	if (!keepMesh)
+	{
+		std::lock_guard lock(displayMutex);
+		jobMeshes.clear();
+	}
+	UpdateJobs();
+}
+
+void FilteringRenderer::UseWarmStart(bool use)
+{
+	useWarmStart = use;
+	if (!useWarmStart) warmStarts.clear();
+	UpdateJobs();
+}
+
+void FilteringRenderer::AdaptSeedNum(bool adapt)
+{
+	adaptSeedNum = adapt;
+	{
+		std::lock_guard lock(displayMutex);
+		jobSeedStats.clear();
+	}
 	UpdateJobs();
 }
 
 std::optional<std::shared_ptr<Seeds>> FilteringRenderer::GetSeeds(size_t id)
 {
+	std::lock_guard lock(displayMutex);
 	if (jobSeeds.contains(id))
 		return jobSeeds[id];
 	else
@@ -66,173 +92,494 @@ std::optional<std::shared_ptr<Seeds>> FilteringRenderer::GetSeeds(size_t id)
 
 std::optional<std::shared_ptr<Mesh>> FilteringRenderer::GetMesh(size_t id)
 {
+	std::lock_guard lock(displayMutex);
 	if (jobMeshes.contains(id))
 		return jobMeshes[id];
 	else
 		return {};
 }
 
+std::optional<SeedStats> FilteringRenderer::GetSeedStats(size_t id)
+{
+	std::lock_guard lock(displayMutex);
+	if (jobSeedStats.contains(id))
+		return jobSeedStats[id];
+	else
+		return {};
+}
+
+static size_t SeedsBytes(const Seeds& seeds)
+{
+	size_t bytes = seeds.capacity() * sizeof(std::vector<Seed>);
+	for (const auto& lane : seeds)
+		bytes += lane.capacity() * sizeof(Seed);
+	return bytes;
+}
+
+void FilteringRenderer::CountCachedMemory(size_t id, MemoryUsage* usage)
+{
+	std::lock_guard lock(displayMutex);
+	if (jobSeeds.contains(id)) usage->seeds = SeedsBytes(*jobSeeds[id]);
+	if (jobMeshes.contains(id)) usage->mesh = jobMeshes[id]->MemoryBytes();
+	if (warmStarts.contains(id)) usage->warmStart = SeedsBytes(warmStarts[id].seeds) + warmStarts[id].funcStr.capacity();
+}
+
+void FilteringRenderer::EvictCaches()
+{
+	// Displayed seeds and meshes are shared, so the canvas keeps any it is still drawing
+	warmStarts.clear();
+	std::lock_guard lock(displayMutex);
+	jobSeeds.clear();
+	jobMeshes.clear();
+}
+
+void FilteringRenderer::ForgetJob(size_t id)
+{
+	warmStarts.erase(id);
+	rootlessViews.erase(id);
+	std::lock_guard lock(displayMutex);
+	jobSeedStats.erase(id);
+	jobSeeds.erase(id);
+	jobMeshes.erase(id);
+}
+
+int FilteringRenderer::MaxResolutionDrop()
+{
+	// Frames never contour below the filter mesh resolution
+	return std::clamp(finalMeshRes - filterMeshRes, 0, maxResolutionDrop);
+}
+
+// Filter mesh boxes holding exactly one of the seeds, seeds outside the mesh aren't counted
+static size_t SingleSeedBoxes(const Seeds& seeds, const Mesh& mesh)
+{
+	std::vector<uint8_t> counts((size_t)mesh.dim * mesh.dim);
+	size_t single = 0;
+	for (const auto& lane : seeds)
+	{
+		for (const Seed& s : lane)
+		{
+			int64_t boxXI = (int64_t)floor((s.x - mesh.bounds.xmin) / mesh.bounds.w() * mesh.dim);
+			int64_t boxYI = (int64_t)floor((s.y - mesh.bounds.ymin) / mesh.bounds.h() * mesh.dim);
+			if (boxXI < 0 || boxXI >= mesh.dim || boxYI < 0 || boxYI >= mesh.dim) continue;
+
+			uint8_t& count = counts[(size_t)boxYI * mesh.dim + boxXI];
+			if (count == 0) single++;
+			else if (count == 1) single--;
+			count = std::min(count + 1, 2);
+		}
+	}
+	return single;
+}
+
 void FilteringRenderer::ProcessJob(Job* job)
 {
 	job->funcs.Resize(pool.get_thread_count());
 
 	Bounds bounds = job->bounds;
+	frameMeshRes = std::max(finalMeshRes - job->resolutionDrop, filterMeshRes);
 
-	Timer frameTimer;
+	job->timings = {};
+	job->funcs.ResetEvalCounts();
+	ZONE(frame, &events, job->id);
+	STAGE_ZONE(seeding, &events, job->id, &job->timings);
+
+	// Seeds are rasterized into the mesh by the threads which generate them
+	mesh.Reset(filterMeshRes);
+	seedBoxes.Reset(filterMeshRes);
+	mesh.bounds = bounds;
+	seedBoxes.bounds = bounds;
 
 	// ===== Seed Generation =====
+	seeds.resize(deterministic ? deterministicLanes : pool.get_thread_count());
 	for (auto& vec : seeds)
 		vec.clear();
 
-	int threadNum = pool.get_thread_count();
-	int seedsPerThread = seedNum / threadNum;
-	std::vector<std::future<void>> futs;
-	for (int ti = 0; ti < threadNum; ti++)
-		futs.push_back(pool.submit(ProximalBracketingGenerator::Generate, &seeds[ti], job->funcs[ti], bounds, 16, filterMeshRes, seedsPerThread));
+	SeedStats stats;
+	stats.seedNum = GetJobSeedNum(job->id);
 
-	for (auto& fut : futs)
-		fut.wait();
+	auto seedStart = std::chrono::steady_clock::now();
+	// Warm starting depends on previous frames, so is skipped in deterministic mode
+	bool warmStart = useWarmStart && !deterministic;
+	if (!warmStart || !GenerateWarmSeeds(job, bounds, stats.seedNum, &stats.requested))
+		GenerateSeeds(job, bounds, bounds.Expand(BOUNDS_EXPANSION), stats.seedNum, &stats.requested);
+	for (const auto& seedVec : seeds)
+		stats.produced += seedVec.size();
+
+	if (stats.produced == 0)
+		EscalateSeeding(job, bounds, &stats);
+
+	stats.duration = std::chrono::steady_clock::now() - seedStart;
+
+	if (warmStart)
+		warmStarts[job->id] = { bounds, job->funcs.GetFuncStr(), filterMeshRes, seedNum, seeds };
 
 	if (keepSeeds)
 	{
-		if (jobSeeds.contains(job->id))
-			*jobSeeds[job->id] = seeds;
-		else
-			jobSeeds[job->id] = std::make_shared<Seeds>(seeds);
+		auto snapshot = std::make_shared<Seeds>(seeds);
+		std::lock_guard lock(displayMutex);
+		jobSeeds[job->id].swap(snapshot);
 	}
+	END_ZONE(seeding);
 
 	// ===== Mesh Generation =====
-	mesh.boxes.resize(Pow4(filterMeshRes));
-	memset(mesh.boxes.data(), false, mesh.boxes.size());
-
-	mesh.bounds = bounds;
-	mesh.dim = (int)Pow2(filterMeshRes);
-
 	// Enable mesh boxes containing or neigbouring seeds
-	for (const auto& seedVec : seeds)
+	STAGE_ZONE(mesh, &events, job->id, &job->timings);
+	mesh.Dilate(seedBoxes);
+	mesh.BuildIndex();
+
+	stats.singleBoxes = SingleSeedBoxes(seeds, seedBoxes);
+	stats.activeBoxes = mesh.Count();
 	{
-		for (const Seed& s : seedVec)
-			InsertSeed(s);
+		std::lock_guard lock(displayMutex);
+		jobSeedStats[job->id] = stats;
 	}
 
 	if (keepMesh)
 	{
-		if (jobMeshes.contains(job->id))
-			*jobMeshes[job->id] = mesh;
-		else
-			jobMeshes[job->id] = std::make_shared<Mesh>(mesh);
+		auto snapshot = std::make_shared<Mesh>(mesh);
+		std::lock_guard lock(displayMutex);
+		jobMeshes[job->id].swap(snapshot);
 	}
+	END_ZONE(mesh);
 
 	// ===== Contouring =====
-	job->verts.clear();
-	ContourMesh(job->verts, job->funcs);
+	job->ResetVerts(mesh.bounds);
+	ContourMesh(job);
 
-	frameTimer.Stop(false);
-	std::cout << frameTimer.GetDuration().count() << '\n';
+	uint64_t gridDim = Pow2(frameMeshRes) + 1;
+	job->evals = job->funcs.GetEvalCounts();
+	job->evals.gridSamples = gridDim * gridDim;
 }
 
-void FilteringRenderer::InsertSeed(const Seed& s)
+int FilteringRenderer::GetJobSeedNum(size_t id)
 {
-	int64_t boxXI = (int64_t)floor((s.x - mesh.bounds.xmin) / mesh.bounds.w() * mesh.dim);
-	int64_t boxYI = (int64_t)floor((s.y - mesh.bounds.ymin) / mesh.bounds.h() * mesh.dim);
-
-	bool xFullyIn = (boxXI > 0) && (boxXI < mesh.dim - 1);
-	bool yFullyIn = (boxYI > 0) && (boxYI < mesh.dim - 1);
+	std::lock_guard lock(displayMutex);
+	if (!adaptSeedNum || deterministic || !jobSeedStats.contains(id)) return seedNum;
+	return NextSeedNum(jobSeedStats[id]);
+}
 
-	if (xFullyIn && yFullyIn) [[likely]]
+int FilteringRenderer::NextSeedNum(const SeedStats& stats) const
+{
+	// Parameters
+	static constexpr int minSeedNum = 256;
+	static constexpr int maxSeedNum = 131072;
+	static constexpr double missedShare = 1.0 / 64; // Estimated share of the curve's boxes left without a seed
+	static constexpr double maxGrowth = 2.0; // While nearly every seed is alone in its box the curve's extent is unknown
+	static constexpr double smoothing = 0.5; // Weight of the previous budget, damps oscillation
+	static constexpr std::chrono::milliseconds maxGrowthTime{ 20 }; // Don't grow past this seeding time
+
+	double target;
+	if (stats.produced == 0 && stats.fallbackProduced == 0)
 	{
-		int64_t index = boxYI * mesh.dim + boxXI;
-		mesh.boxes[index] = true;
-		mesh.boxes[index + 1] = true;
-		mesh.boxes[index - 1] = true;
-		mesh.boxes[index + mesh.dim] = true;
-		mesh.boxes[index - mesh.dim] = true;
+		// Nothing to find, or nothing more seeds found, so more would only cost time
+		target = stats.seedNum;
 	}
-	else [[unlikely]]
+	else if (stats.produced == 0)
 	{
-		bool fullyOut = (boxXI < -1) || (boxXI > mesh.dim)
-			|| (boxYI < -1) || (boxYI > mesh.dim);
-		
-		if (fullyOut) return;
-
-		// All the edge cases
-		// Self, U, D, R, L
-		bool adj[5] = { true, true, true, true, true };
-		if (boxXI == 0)
-		{
-			adj[4] = false;
-		}
-		else if (boxXI == mesh.dim - 1)
-		{
-			adj[3] = false;
-		}
-		else if (boxXI == -1)
-		{
-			adj[0] = false;
-			adj[1] = false;
-			adj[2] = false;
-			adj[4] = false;
-		}
-		else if (boxXI == mesh.dim)
-		{
-			adj[0] = false;
-			adj[1] = false;
-			adj[2] = false;
-			adj[3] = false;
-		}
+		// Only the fallbacks found the curve, spend more effort on random seeds next time
+		target = stats.seedNum * maxGrowth;
+	}
+	else
+	{
+		// The share of seeds alone in their box estimates how much of the curve no seed reached (Good-Turing).
+		// With seeds scattered at random over the curve's boxes it is e^-(seeds per box), so the budget is
+		// scaled by the load needed to bring it down to missedShare over the load seen.
+		double aloneShare = std::max((double)stats.singleBoxes, 0.5) / stats.produced;
+		double load = std::max(-std::log(aloneShare), -std::log(missedShare) / maxGrowth);
+		target = stats.seedNum * -std::log(missedShare) / load;
+	}
 
-		if (boxYI == 0)
+	if (target > stats.seedNum && stats.duration > maxGrowthTime)
+		target = stats.seedNum;
+
+	double next = smoothing * stats.seedNum + (1.0 - smoothing) * target;
+	return std::clamp((int)next, minSeedNum, maxSeedNum);
+}
+
+uint32_t FilteringRenderer::LaneSeed(int lane)
+{
+	if (deterministic)
+		return ProximalBracketingGenerator::LaneSeed(deterministicSeed, lane);
+	else
+		return rd();
+}
+
+void FilteringRenderer::GenerateSeeds(Job* job, const Bounds& bounds, const Bounds& sampleBounds, int jobSeedNum, size_t* requested, int laneOffset)
+{
+	int laneNum = (int)seeds.size();
+	int seedsPerLane = jobSeedNum / laneNum;
+	*requested = (size_t)seedsPerLane * laneNum;
+
+	std::vector<uint32_t> rngSeeds(laneNum);
+	for (int li = 0; li < laneNum; li++)
+		rngSeeds[li] = LaneSeed(li + laneOffset);
+
+	ForEachLane(job, [&](int li, Function* funcPtr)
 		{
-			adj[2] = false;
-		}
-		else if (boxYI == mesh.dim - 1)
+			ProximalBracketingGenerator::Generate(&seeds[li], funcPtr, bounds, sampleBounds, 16, filterMeshRes, seedsPerLane, rngSeeds[li]);
+		});
+}
+
+void FilteringRenderer::EscalateSeeding(Job* job, const Bounds& bounds, SeedStats* stats)
+{
+	// Parts of the view an earlier frame found rootless with every fallback aren't searched again. Verdicts
+	// depend on earlier frames, so like warm starts they aren't used in deterministic mode.
+	std::vector<Bounds> regions = { bounds };
+	auto verdictIt = rootlessViews.find(job->id);
+	if (!deterministic && verdictIt != rootlessViews.end() && verdictIt->second.funcStr == job->funcs.GetFuncStr()
+		&& verdictIt->second.filterMeshRes == filterMeshRes)
+	{
+		auto exposedOpt = ExposedRegions(bounds, verdictIt->second.bounds);
+		if (exposedOpt.has_value()) regions = exposedOpt.value();
+	}
+
+	// Only where to search is narrowed, seeds are still refined against the whole view's filter mesh
+	for (const Bounds& region : regions)
+	{
+		GenerateFallbackSeeds(job, bounds, region.Expand(BOUNDS_EXPANSION), stats);
+		if (stats->fallbackProduced > 0) break;
+	}
+
+	// Whatever the verdict didn't cover has now been searched too
+	if (stats->fallbackProduced == 0 && !deterministic)
+		rootlessViews[job->id] = { bounds, job->funcs.GetFuncStr(), filterMeshRes };
+	else
+		rootlessViews.erase(job->id);
+}
+
+void FilteringRenderer::GenerateFallbackSeeds(Job* job, const Bounds& bounds, const Bounds& sampleBounds, SeedStats* stats)
+{
+	// Parameters
+	static constexpr int retryFactor = 4; // Seed budget multiplier for the random retry
+	static constexpr int scanGridRes = 7; // Grid scan resolution as a power of 2
+	static constexpr int subdivGridRes = 4; // Starting subdivision grid as a power of 2
+	static constexpr int subdivExtraDepth = 3; // Subdivide this many levels below the filter mesh
+	static constexpr int64_t subdivEvalBudget = 262144; // Function evaluations per job, split between lanes
+
+	int laneNum = (int)seeds.size();
+	auto countSeeds = [&]()
 		{
-			adj[1] = false;
-		}
-		else if (boxYI == -1)
+			size_t count = 0;
+			for (const auto& seedVec : seeds)
+				count += seedVec.size();
+			return count;
+		};
+
+	// Retry with more random seeds, using lane seeds distinct from the first attempt
+	stats->stage = SeedStage::RETRY;
+	size_t retryRequested;
+	GenerateSeeds(job, bounds, sampleBounds, stats->seedNum * retryFactor, &retryRequested, laneNum);
+	stats->fallbackProduced = countSeeds();
+	if (stats->fallbackProduced > 0) return;
+
+	// Bracket along every edge of a regular grid, catching curves the random samples straddled
+	stats->stage = SeedStage::GRID_SCAN;
+	int scanDim = (int)Pow2(scanGridRes);
+	ForEachLane(job, [&](int li, Function* funcPtr)
 		{
-			adj[2] = false;
-			adj[3] = false;
-			adj[4] = false;
-			adj[0] = false;
-		}
-		else if (boxYI == mesh.dim)
+			ProximalBracketingGenerator::GridScan(&seeds[li], funcPtr, bounds, sampleBounds, scanGridRes,
+				scanDim * li / laneNum, scanDim * (li + 1) / laneNum, filterMeshRes);
+		});
+	stats->fallbackProduced = countSeeds();
+	if (stats->fallbackProduced > 0) return;
+
+	// Subdivide cells which might hide a root, for small closed curves and tangencies
+	stats->stage = SeedStage::SUBDIVISION;
+	int subdivDim = (int)Pow2(subdivGridRes);
+	int maxDepth = std::max(filterMeshRes + subdivExtraDepth - subdivGridRes, 0);
+	ForEachLane(job, [&](int li, Function* funcPtr)
 		{
-			adj[0] = false;
-			adj[1] = false;
-			adj[3] = false;
-			adj[4] = false;
-		}
+			// Per lane budgets keep the result independent of scheduling
+			int64_t evalBudget = subdivEvalBudget / laneNum;
+			ProximalBracketingGenerator::Subdivide(&seeds[li], funcPtr, bounds, sampleBounds, subdivGridRes,
+				subdivDim * li / laneNum, subdivDim * (li + 1) / laneNum, maxDepth, filterMeshRes, &evalBudget);
+		});
+	stats->fallbackProduced = countSeeds();
+}
+
+template <typename F>
+void FilteringRenderer::ForEachLane(Job* job, F laneFun)
+{
+	int threadNum = pool.get_thread_count();
+	int laneNum = (int)seeds.size();
+
+	// Each thread works through every threadNum'th lane using its own function copy
+	std::vector<std::future<void>> futs;
+	for (int ti = 0; ti < std::min(threadNum, laneNum); ti++)
+	{
+		futs.push_back(pool.submit([=, this, &laneFun]()
+			{
+				ZONE(seed_lanes, &events, job->id);
+				for (int li = ti; li < laneNum; li += threadNum)
+				{
+					laneFun(li, job->funcs[ti]);
+
+					for (const Seed& s : seeds[li])
+						InsertSeed(s);
+				}
+			}));
+	}
+
+	for (auto& fut : futs)
+		fut.wait();
+}
+
+bool FilteringRenderer::GenerateWarmSeeds(Job* job, const Bounds& bounds, int jobSeedNum, size_t* requested)
+{
+	// Parameters
+	static constexpr double maxZoomRatio = 2.0; // Furthest zoom in either direction before a cold start
+	static constexpr int refreshDivisor = 8; // Fraction of the seed budget spread over the whole view
+	static constexpr int minRegionSeeds = 8;
+
+	auto prevIt = warmStarts.find(job->id);
+	if (prevIt == warmStarts.end()) return false;
+	const WarmStart& prev = prevIt->second;
+
+	// Previous seeds are only reusable if they were found on the same curve at a similar scale
+	if (prev.funcStr != job->funcs.GetFuncStr()) return false;
+	if (prev.filterMeshRes != filterMeshRes || prev.seedNum != seedNum) return false;
+	if (prev.seeds.size() != seeds.size()) return false;
+
+	double zoomRatio = bounds.w() / prev.bounds.w();
+	if (zoomRatio > maxZoomRatio || zoomRatio < 1.0 / maxZoomRatio) return false;
+
+	auto exposedOpt = ExposedRegions(bounds.Expand(BOUNDS_EXPANSION), prev.bounds.Expand(BOUNDS_EXPANSION));
+	if (!exposedOpt.has_value()) return false;
+	const std::vector<Bounds>& exposed = exposedOpt.value();
+
+	// Carry over old seeds and top up with fresh ones in newly exposed areas
+	int threadNum = pool.get_thread_count();
+	int seedsPerThread = jobSeedNum / threadNum;
+	double viewArea = bounds.w() * bounds.h() * BOUNDS_EXPANSION * BOUNDS_EXPANSION;
 
-		int64_t index = boxYI * mesh.dim + boxXI;
-		if (adj[0]) mesh.boxes[index] = true;
-		if (adj[3]) mesh.boxes[index + 1] = true;
-		if (adj[4]) mesh.boxes[index - 1] = true;
-		if (adj[1]) mesh.boxes[index + mesh.dim] = true;
-		if (adj[2]) mesh.boxes[index - mesh.dim] = true;
+	std::vector<size_t> threadRequested(threadNum);
+	std::vector<std::future<void>> futs;
+	for (int ti = 0; ti < threadNum; ti++)
+	{
+		uint32_t rngSeed = LaneSeed(ti);
+		futs.push_back(pool.submit([=, this, &prev, &exposed, &threadRequested]()
+			{
+				ZONE(warm_seeds, &events, job->id);
+				ProximalBracketingGenerator::Revalidate(&seeds[ti], &prev.seeds[ti], job->funcs[ti], bounds, filterMeshRes, seedsPerThread);
+				threadRequested[ti] = seeds[ti].size();
+
+				for (size_t ri = 0; ri < exposed.size(); ri++)
+				{
+					const Bounds& region = exposed[ri];
+					int regionSeeds = std::max((int)ceil(seedsPerThread * region.w() * region.h() / viewArea), minRegionSeeds);
+					ProximalBracketingGenerator::Generate(&seeds[ti], job->funcs[ti], bounds, region, 16, filterMeshRes, regionSeeds, rngSeed + 1 + (uint32_t)ri);
+					threadRequested[ti] += regionSeeds;
+				}
+
+				// A small number of seeds over the whole view so components missed in earlier frames are still found
+				int refreshSeeds = std::max(seedsPerThread / refreshDivisor, minRegionSeeds);
+				ProximalBracketingGenerator::Generate(&seeds[ti], job->funcs[ti], bounds, 16, filterMeshRes, refreshSeeds, rngSeed);
+				threadRequested[ti] += refreshSeeds;
+
+				for (const Seed& s : seeds[ti])
+					InsertSeed(s);
+			}));
 	}
+
+	for (auto& fut : futs)
+		fut.wait();
+
+	*requested = 0;
+	for (size_t n : threadRequested)
+		*requested += n;
+
+	return true;
+}
+
+std::optional<std::vector<Bounds>> FilteringRenderer::ExposedRegions(const Bounds& current, const Bounds& previous)
+{
+	// Intersection of the two regions
+	double ixmin = std::max(current.xmin, previous.xmin);
+	double ixmax = std::min(current.xmax, previous.xmax);
+	double iymin = std::max(current.ymin, previous.ymin);
+	double iymax = std::min(current.ymax, previous.ymax);
+
+	if (ixmin >= ixmax || iymin >= iymax) return {};
+
+	// Split the uncovered area into at most four rectangles
+	std::vector<Bounds> regions;
+	if (current.xmin < ixmin) regions.emplace_back(current.xmin, current.ymin, ixmin, current.ymax); // Left
+	if (current.xmax > ixmax) regions.emplace_back(ixmax, current.ymin, current.xmax, current.ymax); // Right
+	if (current.ymin < iymin) regions.emplace_back(ixmin, current.ymin, ixmax, iymin); // Bottom
+	if (current.ymax > iymax) regions.emplace_back(ixmin, iymax, ixmax, current.ymax); // Top
+
+	return regions;
 }
 
-void FilteringRenderer::ContourMesh(std::vector<double>& lineVerts, FunctionPack& funcs) 
+void FilteringRenderer::InsertSeed(const Seed& s)
 {
+	int64_t boxXI = (int64_t)floor((s.x - mesh.bounds.xmin) / mesh.bounds.w() * mesh.dim);
+	int64_t boxYI = (int64_t)floor((s.y - mesh.bounds.ymin) / mesh.bounds.h() * mesh.dim);
+
+	bool xIn = (boxXI >= 0) && (boxXI < mesh.dim);
+	bool yIn = (boxYI >= 0) && (boxYI < mesh.dim);
+
+	if (xIn && yIn) [[likely]]
+	{
+		// Neighbours are enabled later by dilating all seed boxes at once
+		seedBoxes.Set((int)boxXI, (int)boxYI);
+	}
+	else if (yIn) [[unlikely]]
+	{
+		// Seeds just outside the mesh only enable the neighbouring box inside it
+		if (boxXI == -1) mesh.Set(0, (int)boxYI);
+		else if (boxXI == mesh.dim) mesh.Set(mesh.dim - 1, (int)boxYI);
+	}
+	else if (xIn) [[unlikely]]
+	{
+		if (boxYI == -1) mesh.Set((int)boxXI, 0);
+		else if (boxYI == mesh.dim) mesh.Set((int)boxXI, mesh.dim - 1);
+	}
+}
+
+void FilteringRenderer::ContourMesh(Job* job)
+{
+	std::vector<float>& lineVerts = job->verts;
+	FunctionPack& funcs = job->funcs;
+
 	// Compute a few useful values
-	uint64_t finalDim = (uint64_t)1 << finalMeshRes;
+	uint64_t finalDim = (uint64_t)1 << frameMeshRes;
 	uint64_t bufSize = finalDim + 1;
+	uint64_t sqsPerTile = finalDim / mesh.dim;
+
+	// Only rows between the first and last active mesh rows can contain lines
+	int firstActive = 0, lastActive = mesh.dim - 1;
+	while (firstActive < mesh.dim && mesh.RowSpans(firstActive).empty()) firstActive++;
+	while (lastActive >= firstActive && mesh.RowSpans(lastActive).empty()) lastActive--;
+	if (firstActive > lastActive) return;
+
+	uint64_t lowRow = firstActive * sqsPerTile;
+	uint64_t highRow = std::min((lastActive + 1) * sqsPerTile, finalDim);
 
 	// Calculate which regions of the image to dedicate to each thread
-	int threadNum = pool.get_thread_count();
+	int threadNum = (int)std::min((uint64_t)pool.get_thread_count(), highRow - lowRow);
 	funcs.Resize(threadNum + 1);
 
 	std::vector<uint64_t> startRows(threadNum);
 	std::vector<uint64_t> endRows(threadNum);
 
 	for (int ti = 0; ti < threadNum; ti++)
-		startRows[ti] = finalDim * ti / threadNum;
+		startRows[ti] = lowRow + (highRow - lowRow) * ti / threadNum;
 	for (int ti = 0; ti < threadNum - 1; ti++)
 		endRows[ti] = startRows[ti + 1] - 1;
-	endRows[threadNum - 1] = finalDim - 1;
+	endRows[threadNum - 1] = highRow - 1;
+
+	// Skip bands which have no active mesh boxes in or next to them
+	std::vector<bool> bandActive(threadNum);
+	for (int ti = 0; ti < threadNum; ti++)
+	{
+		int meshStart = (int)(startRows[ti] / sqsPerTile) - 1;
+		int meshEnd = (int)(endRows[ti] / sqsPerTile) + 2;
+		bandActive[ti] = mesh.AnyActive(0, meshStart, mesh.dim, meshEnd);
+	}
 
 	// First compute the values on the boundaries of the thread areas
+	STAGE_ZONE(fill, &events, job->id, &job->timings);
 	std::vector<ValueBuffer> boundaries;
 	boundaries.reserve(threadNum + 1);
 	for (int i = 0; i <= threadNum; i++)
@@ -241,88 +588,125 @@ void FilteringRenderer::ContourMesh(std::vector<double>& lineVerts, FunctionPack
 	std::vector<std::future<void>> futs;
 	for (int ti = 0; ti <= threadNum; ti++)
 	{
-		uint64_t gy = (ti < threadNum) ? startRows[ti] : finalDim;
+		bool needed = (ti < threadNum && bandActive[ti]) || (ti > 0 && bandActive[ti - 1]);
+		if (!needed) continue;
+
+		uint64_t gy = (ti < threadNum) ? startRows[ti] : highRow;
 		ValueBuffer* outPtr = &boundaries[ti];
 		Function* funcPtr = funcs[ti];
-		futs.push_back(pool.submit([=, this]() { this->FillBuffer(outPtr, funcPtr, gy); }));
+		futs.push_back(pool.submit([=, this]()
+			{
+				ZONE(fill_boundary, &events, job->id);
+				funcPtr->SetEvalStage(EvalStage::BOUNDARY_FILL);
+				this->FillBuffer(outPtr, funcPtr, gy);
+			}));
 	}
 	for (auto& future : futs) future.wait();
+	END_ZONE(fill);
 
 	// Initialize threads to fully contour one section of the image each
-	std::vector<std::vector<double>> threadOutputs(threadNum);
+	STAGE_ZONE(contour, &events, job->id, &job->timings);
+	futs.clear();
+	std::vector<std::vector<float>> threadOutputs(threadNum);
+	double xOrigin = job->xOrigin, yOrigin = job->yOrigin;
 	for (int ti = 0; ti < threadNum; ti++)
 	{
-		std::vector<double>* outPtr = &threadOutputs[ti];
+		if (!bandActive[ti]) continue;
+
+		std::vector<float>* outPtr = &threadOutputs[ti];
 		Function* funcPtr = funcs[ti];
 		ValueBuffer* bottom = &boundaries[ti];
 		ValueBuffer* top = &boundaries[ti + 1];
-		futs[ti] = pool.submit([=, this]() { this->ContourRows(outPtr, funcPtr, startRows[ti], endRows[ti], bottom, top); });
+		futs.push_back(pool.submit([=, this]()
+			{
+				ZONE(contour_band, &events, job->id);
+				this->ContourRows(outPtr, xOrigin, yOrigin, funcPtr, startRows[ti], endRows[ti], bottom, top);
+			}));
 	}
 
 	for (auto& future : futs) future.wait();
+	END_ZONE(contour);
 
-	// Collect outputs into a single vector
+	// Collect outputs into a single vector, in row order so the result doesn't depend on the thread count
+	STAGE_ZONE(collect, &events, job->id, &job->timings);
 	uint64_t finalValueNum = 0;
 	for (const auto& vec : threadOutputs) finalValueNum += vec.size();
 
 	lineVerts.reserve(finalValueNum);
 	for (int ti = 0; ti < threadNum; ti++)
 	{
-		for (double v : threadOutputs[ti])
-			lineVerts.push_back(v);
+		lineVerts.insert(lineVerts.end(), threadOutputs[ti].begin(), threadOutputs[ti].end());
 	}
+
+	job->memory.transient = 0;
+	for (const auto& vec : threadOutputs) job->memory.transient += vec.capacity() * sizeof(float);
+	for (const auto& buf : boundaries) job->memory.transient += buf.vals.capacity() * sizeof(double) + buf.active.capacity();
 }
 
-void FilteringRenderer::ContourRows(std::vector<double>* lineVerts, Function* funcPtr,
+void FilteringRenderer::ContourRows(std::vector<float>* lineVerts, double xOrigin, double yOrigin, Function* funcPtr,
 	uint64_t startRow, uint64_t endRow, const ValueBuffer* bottom, const ValueBuffer* top) const
 {
 	// References and useful values
 	const Bounds& bounds = mesh.bounds;
-	uint64_t finalDim = (uint64_t)1 << finalMeshRes;
+	uint64_t finalDim = (uint64_t)1 << frameMeshRes;
 	double dx = bounds.w() / finalDim; // Width of grid squares
 	double dy = bounds.h() / finalDim; // Height of grid squares
+	funcPtr->SetEvalStage(EvalStage::ROW_FILL);
+
+	// Corners are placed relative to the origin, going through world coordinates would round them to the precision of xmin
+	double x0 = bounds.xmin - xOrigin;
+	double y0 = bounds.ymin - yOrigin;
 
 	uint64_t bufSize = finalDim + 1;
 	ValueBuffer downBuf(bufSize), upBuf(bufSize);
+	std::vector<Span> downSquares, upSquares, squareSpans;
 
 	// Fill downBuf with values from param
 	downBuf = *bottom;
+	SquareSpans(FillSpans(startRow), &downSquares);
 
 	for (uint64_t gy = startRow + 1; gy <= endRow + 1; gy++)
 	{
-		// Fill upBuf with values
+		// Squares can only have all four corners filled where both rows were filled
+		SquareSpans(FillSpans(gy), &upSquares);
+		IntersectSpans(downSquares, upSquares, &squareSpans);
+
+		// Fill upBuf with values, rows with no filled squares are left untouched
 		if (gy < endRow + 1)
-			FillBuffer(&upBuf, funcPtr, gy);
+		{
+			if (!FillSpans(gy).empty())
+				FillBuffer(&upBuf, funcPtr, gy);
+		}
 		else
 			upBuf = *top;
 
 		// Compare buffers to identify squares with lines
-		for (uint64_t gx = 0; gx < finalDim; gx++)
+		for (const Span& span : squareSpans)
 		{
-			// Check if whole square is valid
-			if (downBuf.active[gx] && downBuf.active[gx + 1] && upBuf.active[gx] && upBuf.active[gx + 1]) {}
-			else { continue; }
-
-			double lx = (double)gx / finalDim * bounds.w() + bounds.xmin; // Left x-coord
-			double ty = (double)gy / finalDim * bounds.h() + bounds.ymin; // Top y-coord
-
-			double xs[4] = { lx, lx + dx, lx + dx, lx };
-			double ys[4] = { ty, ty, ty - dy, ty - dy };
-			double vals[4] = { upBuf[gx], upBuf[gx + 1], downBuf[gx + 1], downBuf[gx] };
-			Lines lines = GetTileLines(xs, ys, vals);
-
-			for (int n = 0; n < lines.n; n++)
+			for (uint64_t gx = span.start; gx < (uint64_t)span.end; gx++)
 			{
-				lineVerts->push_back(lines.xs[n * 2]);
-				lineVerts->push_back(lines.ys[n * 2]);
-				lineVerts->push_back(lines.xs[n * 2 + 1]);
-				lineVerts->push_back(lines.ys[n * 2 + 1]);
+				double lx = (double)gx / finalDim * bounds.w() + x0; // Left x-coord
+				double ty = (double)gy / finalDim * bounds.h() + y0; // Top y-coord
+
+				double xs[4] = { lx, lx + dx, lx + dx, lx };
+				double ys[4] = { ty, ty, ty - dy, ty - dy };
+				double vals[4] = { upBuf.vals[gx], upBuf.vals[gx + 1], downBuf.vals[gx + 1], downBuf.vals[gx] };
+				Lines lines = GetTileLines(xs, ys, vals);
+
+				for (int n = 0; n < lines.n; n++)
+				{
+					lineVerts->push_back((float)lines.xs[n * 2]);
+					lineVerts->push_back((float)lines.ys[n * 2]);
+					lineVerts->push_back((float)lines.xs[n * 2 + 1]);
+					lineVerts->push_back((float)lines.ys[n * 2 + 1]);
+				}
 			}
 		}
 
 		// Swap buffers
 		std::swap(downBuf.vals, upBuf.vals);
 		std::swap(downBuf.active, upBuf.active);
+		std::swap(downSquares, upSquares);
 	}
 }
 
@@ -336,23 +720,19 @@ void FilteringRenderer::FillBuffer(ValueBuffer* bufPtr, Function* funcPtr, uint6
 	buf.SetAllActive(false);
 
 	// Calculate useful values
-	uint64_t finalDim = (uint64_t)1 << finalMeshRes;
+	uint64_t finalDim = (uint64_t)1 << frameMeshRes;
 	int sqsPerTile = (int)(finalDim / mesh.dim);
 	double worldY = (double)y / finalDim * bounds.h() + bounds.ymin;
 	double delX = bounds.w() / finalDim;
 
-	if (y == 0 || y == finalDim || y % sqsPerTile != 0) // top, bottom, or non-boundary row
+	// Fill every tile in each span, plus the leftmost value of the tile after it
+	for (const Span& span : FillSpans(y))
 	{
-		bool currentTile, lastTile = false;
-
-		uint64_t filterRowOffset = ((y == finalDim) ? (mesh.dim - 1) : y / sqsPerTile) * mesh.dim; // Offset for accessing filter-mesh arr
-		uint64_t tileStartIndex = 0;
-		for (int majorX = 0; majorX < mesh.dim; majorX++, tileStartIndex += sqsPerTile, lastTile = currentTile)
+		uint64_t tileStartIndex = (uint64_t)span.start * sqsPerTile;
+		for (int majorX = span.start; majorX < span.end; majorX++, tileStartIndex += sqsPerTile)
 		{
-			currentTile = mesh.boxes[filterRowOffset + majorX];
 			double worldX = tileStartIndex * delX + bounds.xmin;
-			if (lastTile || currentTile) buf[tileStartIndex] = func(worldX, worldY); // leftmost value
-			if (!currentTile) continue; //Skip this tile
+			buf[tileStartIndex] = func(worldX, worldY); // leftmost value
 
 			// Fill all 'fully-internal' tile values
 			for (int minorX = 1; minorX < sqsPerTile; minorX++)
@@ -362,30 +742,56 @@ void FilteringRenderer::FillBuffer(ValueBuffer* bufPtr, Function* funcPtr, uint6
 				buf[bufIndex] = func(worldX, worldY);
 			}
 		}
-		if (lastTile) buf[finalDim] = func(bounds.xmax, worldY);
+
+		if (span.end == mesh.dim) buf[finalDim] = func(bounds.xmax, worldY);
+		else buf[tileStartIndex] = func(tileStartIndex * delX + bounds.xmin, worldY);
 	}
-	else // Boundary row
+}
+
+const std::vector<Span>& FilteringRenderer::FillSpans(uint64_t y) const
+{
+	uint64_t finalDim = (uint64_t)1 << frameMeshRes;
+	uint64_t sqsPerTile = finalDim / mesh.dim;
+
+	if (y == 0 || y == finalDim || y % sqsPerTile != 0) // top, bottom, or non-boundary row
+		return mesh.RowSpans((int)((y == finalDim) ? (mesh.dim - 1) : y / sqsPerTile));
+	else // Boundary row, tile above and below need to be checked
+		return mesh.EdgeSpans((int)((y - 1) / sqsPerTile));
+}
+
+void FilteringRenderer::SquareSpans(const std::vector<Span>& tileSpans, std::vector<Span>* out) const
+{
+	// A span of tiles [start, end) fills buffer values start * sqsPerTile to end * sqsPerTile inclusive,
+	// the squares with both of their values in one of these ranges are returned
+	int sqsPerTile = (int)(((uint64_t)1 << frameMeshRes) / mesh.dim);
+	out->clear();
+
+	for (const Span& span : tileSpans)
 	{
-		bool currentTile, lastTile = false;
+		int first = span.start * sqsPerTile;
+		int last = span.end * sqsPerTile;
 
-		int64_t filterRowOffset = (y - 1) / sqsPerTile * mesh.dim;
-		uint64_t tileStartIndex = 0;
-		for (int majorX = 0; majorX < mesh.dim; majorX++, tileStartIndex += sqsPerTile, lastTile = currentTile)
-		{
-			// Boundary row, tile above and below need to be checked
-			currentTile = mesh.boxes[filterRowOffset + majorX] || mesh.boxes[filterRowOffset + mesh.dim + majorX];
-			double worldX = tileStartIndex * delX + bounds.xmin;
-			if (lastTile || currentTile) buf[tileStartIndex] = func(worldX, worldY); // leftmost value
-			if (!currentTile) continue; //Skip this tile
+		// Filled ranges which touch join up, only possible with one square per tile
+		if (!out->empty() && first <= out->back().end + 1)
+			out->back().end = last;
+		else
+			out->push_back({ first, last });
+	}
+}
 
-			for (int minorX = 1; minorX < sqsPerTile; minorX++)
-			{
-				worldX += delX;
-				uint64_t bufIndex = tileStartIndex + minorX;
-				buf[bufIndex] = func(worldX, worldY);
-			}
-		}
-		if (lastTile) buf[finalDim] = func(bounds.xmax, worldY);
+void FilteringRenderer::IntersectSpans(const std::vector<Span>& a, const std::vector<Span>& b, std::vector<Span>* out)
+{
+	out->clear();
+
+	size_t ai = 0, bi = 0;
+	while (ai < a.size() && bi < b.size())
+	{
+		int start = std::max(a[ai].start, b[bi].start);
+		int end = std::min(a[ai].end, b[bi].end);
+		if (start < end) out->push_back({ start, end });
+
+		if (a[ai].end < b[bi].end) ai++;
+		else bi++;
 	}
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <map>
 #include <optional>
+#include <chrono>
 
 #include <BS_thread_pool.hpp>
 
@@ -9,26 +10,52 @@
 #include "pow4.h"
 #include "ValueBuffer.h"
 #include "Lines.h"
+#include "Mesh.h"
 
 typedef BS::thread_pool ThreadPool;
 typedef std::vector<std::vector<Seed>> Seeds;
 
-struct Mesh
+struct WarmStart
 {
-	Mesh(int res)
-		: dim((int)Pow2(res)), boxes((size_t)dim * dim) {}
-	Mesh(const std::vector<uint8_t>& boxes_, const Bounds& bounds_, int dim_)
-		: dim(dim_), boxes(boxes_), bounds(bounds_) {}
-
-	int dim;
-	std::vector<uint8_t> boxes;
-	Bounds bounds = { 0.0, 0.0, 0.0, 0.0 };
+	Bounds bounds;
+	std::string funcStr;
+	int filterMeshRes = 0;
+	int seedNum = 0;
+	Seeds seeds;
+};
+
+// A view every seeding stage searched without finding a root, so later frames inside it skip the fallbacks
+struct RootlessView
+{
+	Bounds bounds;
+	std::string funcStr;
+	int filterMeshRes = 0;
+};
+
+// Seeding stages, later ones only run if the earlier ones found nothing
+enum class SeedStage
+{
+	RANDOM,
+	RETRY,
+	GRID_SCAN,
+	SUBDIVISION
+};
+
+struct SeedStats
+{
+	int seedNum = 0; // Seed budget used for the frame
+	size_t requested = 0, produced = 0; // Seeds placed vs refined seeds which came out of bracketing
+	SeedStage stage = SeedStage::RANDOM; // Last stage run
+	size_t fallbackProduced = 0; // Refined seeds found by the fallback stages
+	size_t singleBoxes = 0; // Filter mesh boxes holding exactly one refined seed
+	size_t activeBoxes = 0; // Filter mesh boxes enabled by the seeds
+	std::chrono::nanoseconds duration{ 0 }; // Time spent generating seeds
 };
 
 class FilteringRenderer : public Renderer
 {
 public:
-	FilteringRenderer(CallbackFun refreshFun, int seedNum_ = 2048, int filterMeshRes_ = 5, int finalMeshRes_ = 9);
+	FilteringRenderer(CallbackFun refreshFun, int seedNum_ = 2048, int filterMeshRes_ = 5, int finalMeshRes_ = 9, int threadNum = DefaultThreadNum());
 
 	~FilteringRenderer();
 
@@ -42,30 +69,65 @@ public:
 
 	void KeepSeeds(bool keep);
 	void KeepMesh(bool keep);
+	void UseWarmStart(bool use);
+	void AdaptSeedNum(bool adapt);
 
 	std::optional<std::shared_ptr<Seeds>> GetSeeds(size_t id);
 	std::optional<std::shared_ptr<Mesh>> GetMesh(size_t id);
+	std::optional<SeedStats> GetSeedStats(size_t id);
 
 protected:
 	void ProcessJob(Job* job);
+	void CountCachedMemory(size_t id, MemoryUsage* usage);
+	void EvictCaches();
+	void ForgetJob(size_t id);
+	int MaxResolutionDrop();
+	int GetJobSeedNum(size_t id);
+	int NextSeedNum(const SeedStats& stats) const;
+	uint32_t LaneSeed(int lane);
+	void GenerateSeeds(Job* job, const Bounds& bounds, const Bounds& sampleBounds, int jobSeedNum, size_t* requested, int laneOffset = 0);
+	void EscalateSeeding(Job* job, const Bounds& bounds, SeedStats* stats);
+	void GenerateFallbackSeeds(Job* job, const Bounds& bounds, const Bounds& sampleBounds, SeedStats* stats);
+	template <typename F> void ForEachLane(Job* job, F laneFun);
+	bool GenerateWarmSeeds(Job* job, const Bounds& bounds, int jobSeedNum, size_t* requested);
+	static std::optional<std::vector<Bounds>> ExposedRegions(const Bounds& current, const Bounds& previous);
 	void InsertSeed(const Seed& s);
-	void ContourMesh(std::vector<double>& lineVerts, FunctionPack& funcs);
-	void ContourRows(std::vector<double>* lineVerts, Function* funcPtr, uint64_t startRow, uint64_t endRow, const ValueBuffer* top, const ValueBuffer* bottom) const;
+	void ContourMesh(Job* job);
+	void ContourRows(std::vector<float>* lineVerts, double xOrigin, double yOrigin, Function* funcPtr, uint64_t startRow, uint64_t endRow, const ValueBuffer* top, const ValueBuffer* bottom) const;
 	void FillBuffer(ValueBuffer* bufPtr, Function* funcPtr, uint64_t y) const;
+	const std::vector<Span>& FillSpans(uint64_t y) const;
+	void SquareSpans(const std::vector<Span>& tileSpans, std::vector<Span>* out) const;
+	static void IntersectSpans(const std::vector<Span>& a, const std::vector<Span>& b, std::vector<Span>* out);
 	Lines GetTileLines(double* xs, double* ys, double* vals) const;
 
 	ThreadPool pool;
+	std::random_device rd;
+
+	// Number of seed lanes used in deterministic mode, fixed so seeding doesn't depend on the thread count
+	static constexpr int deterministicLanes = 16;
 
 	int seedNum;
 	int filterMeshRes;
 	int finalMeshRes;
+	int frameMeshRes; // Final mesh resolution of the frame being rendered, lowered under a memory budget
 
 	Seeds seeds;
 	Mesh mesh;
+	Mesh seedBoxes; // Boxes directly containing seeds, before neighbours are enabled
 
+	// Snapshots for display, each frame publishes new ones so a reader's copy is never written to.
+	// The maps are guarded by displayMutex.
+	std::mutex displayMutex;
 	bool keepSeeds = false;
 	std::map<size_t, std::shared_ptr<Seeds>> jobSeeds;
 
 	bool keepMesh = false;
 	std::map<size_t, std::shared_ptr<Mesh>> jobMeshes;
+
+	bool useWarmStart = true;
+	std::map<size_t, WarmStart> warmStarts;
+
+	bool adaptSeedNum = true;
+	std::map<size_t, SeedStats> jobSeedStats; // Guarded by displayMutex, GetSeedStats reads it from other threads
+	std::map<size_t, RootlessView> rootlessViews;
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "Function.h"
 #include <exprtk.hpp>
+#include <algorithm>
 
 Function::Function(std::string_view exprStr_)
 {
@@ -18,6 +19,7 @@ Function::Function(const Function& other)
 
 double Function::operator()(double x_, double y_)
 {
+	evalCounts[evalStage]++;
 	x = x_;
 	y = y_;
 	return expr->value();
@@ -36,4 +38,40 @@ void Function::Construct(std::string_view exprStr_)
 
 	exprtk::parser<double> parser;
 	isValid = parser.compile(exprStr, *expr);
+}
+
+void Function::SetEvalStage(EvalStage stage)
+{
+	evalStage = stage;
+}
+
+const EvalCounts& Function::GetEvalCounts() const
+{
+	return evalCounts;
+}
+
+void Function::ResetEvalCounts()
+{
+	evalCounts = {};
+}
+
+size_t Function::MemoryBytes() const
+{
+	return sizeof(Function) + exprStr.capacity();
+}
+
+uint64_t EvalCounts::Total() const
+{
+	uint64_t total = 0;
+	for (uint64_t count : counts)
+		total += count;
+	return total;
+}
+
+double EvalCounts::FilteredFraction() const
+{
+	if (gridSamples == 0) return 0.0;
+
+	uint64_t filled = (*this)[EvalStage::BOUNDARY_FILL] + (*this)[EvalStage::ROW_FILL];
+	return std::max(1.0 - (double)filled / gridSamples, 0.0);
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include <string>
+#include <array>
+#include <cstdint>
 
 namespace exprtk
 {
@@ -7,6 +9,32 @@ namespace exprtk
 	class expression;
 }
 
+// Pipeline stage a function evaluation is attributed to
+enum class EvalStage
+{
+	SEED_PLACEMENT, // Random seed samples and warm start revalidation
+	NEWTON, // Newton iterations searching for a sign change
+	REFINEMENT, // TOMS748 refinement of bracketed seeds
+	FALLBACK, // Grid scan and subdivision fallbacks
+	BOUNDARY_FILL, // Band boundary rows
+	ROW_FILL, // Interior rows filled while contouring
+	TRACING, // Curve tracing
+	COUNT
+};
+
+struct EvalCounts
+{
+	std::array<uint64_t, (size_t)EvalStage::COUNT> counts{};
+	uint64_t gridSamples = 0; // Samples a full evaluation of the final grid would take
+
+	uint64_t& operator[](EvalStage stage) { return counts[(size_t)stage]; }
+	uint64_t operator[](EvalStage stage) const { return counts[(size_t)stage]; }
+	uint64_t Total() const;
+
+	// Fraction of final grid samples the filter mesh skipped
+	double FilteredFraction() const;
+};
+
 class Function
 {
 public:
@@ -24,10 +52,21 @@ public:
 
 	void Construct(std::string_view exprStr_);
 
+	// Evaluations are counted against the current stage, a function is only ever used by one thread at a time
+	void SetEvalStage(EvalStage stage);
+	const EvalCounts& GetEvalCounts() const;
+	void ResetEvalCounts();
+
+	// Bytes held by the function itself, exprtk's compiled expression tree isn't visible and is excluded
+	size_t MemoryBytes() const;
+
 	bool isValid;
 
 protected:
 	double x = 0, y = 0;
 	exprtk::expression<double>* expr = nullptr;
 	std::string exprStr;
+
+	EvalStage evalStage = EvalStage::SEED_PLACEMENT;
+	EvalCounts evalCounts;
 };
\ No newline at end of file
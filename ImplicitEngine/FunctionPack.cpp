@@ -35,4 +35,35 @@ void FunctionPack::Change(std::string_view funcStr_)
 Function* FunctionPack::operator[](int index)
 {
 	return funcs[index];
+}
+
+const std::string& FunctionPack::GetFuncStr() const
+{
+	return funcStr;
+}
+
+EvalCounts FunctionPack::GetEvalCounts() const
+{
+	EvalCounts total;
+	for (const Function* func : funcs)
+	{
+		const EvalCounts& counts = func->GetEvalCounts();
+		for (size_t si = 0; si < total.counts.size(); si++)
+			total.counts[si] += counts.counts[si];
+	}
+	return total;
+}
+
+void FunctionPack::ResetEvalCounts()
+{
+	for (Function* func : funcs)
+		func->ResetEvalCounts();
+}
+
+size_t FunctionPack::MemoryBytes() const
+{
+	size_t bytes = funcStr.capacity() + funcs.capacity() * sizeof(Function*);
+	for (const Function* func : funcs)
+		bytes += func->MemoryBytes();
+	return bytes;
 }
\ No newline at end of file
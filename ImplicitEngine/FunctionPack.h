@@ -13,6 +13,13 @@ public:
 	void Change(std::string_view funcStr_);
 
 	Function* operator[](int index);
+	const std::string& GetFuncStr() const;
+
+	// Evaluation counts summed over every function in the pack
+	EvalCounts GetEvalCounts() const;
+	void ResetEvalCounts();
+
+	size_t MemoryBytes() const;
 
 	bool isValid;
 
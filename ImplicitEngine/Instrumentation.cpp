@@ -0,0 +1,238 @@
+#include "Instrumentation.h"
+
+#include <thread>
+#include <algorithm>
+#include <set>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC 1
+#else
+#define HAS_TSC 0
+#endif
+
+uint64_t Instrumentation::Ticks()
+{
+#if HAS_TSC
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+double Instrumentation::TicksPerSecond()
+{
+#if HAS_TSC
+	// Calibrated once against the steady clock, invariant TSCs tick at a constant rate
+	static const double ticksPerSecond = []()
+		{
+			static constexpr std::chrono::milliseconds calibrationTime{ 10 };
+
+			auto clockStart = std::chrono::steady_clock::now();
+			uint64_t tickStart = Ticks();
+			std::this_thread::sleep_for(calibrationTime);
+			uint64_t tickEnd = Ticks();
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - clockStart;
+
+			return (tickEnd - tickStart) / elapsed.count();
+		}();
+	return ticksPerSecond;
+#else
+	return 1e9;
+#endif
+}
+
+std::chrono::nanoseconds Instrumentation::ToDuration(uint64_t ticks)
+{
+	return std::chrono::nanoseconds((int64_t)(ticks / TicksPerSecond() * 1e9));
+}
+
+uint32_t Instrumentation::ThreadIndex()
+{
+	static std::atomic<uint32_t> nextIndex{ 0 };
+	thread_local uint32_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
+
+static Instrumentation::StageHook stageHook = nullptr;
+
+void Instrumentation::SetStageHook(StageHook hook)
+{
+	stageHook = hook;
+}
+
+void Instrumentation::StageBoundary(const char* name, bool start)
+{
+	if (stageHook) stageHook(name, start);
+}
+
+void Instrumentation::WriteChromeTrace(std::ostream& out, const std::vector<ZoneEvent>& events, const std::map<uint32_t, std::string>& threadNames)
+{
+	uint64_t base = UINT64_MAX;
+	std::set<uint32_t> threads;
+	for (const ZoneEvent& event : events)
+	{
+		base = std::min(base, event.start);
+		threads.insert(event.thread);
+	}
+
+	// Timestamps are in microseconds from the first event
+	auto toMicros = [](uint64_t ticks) { return ToDuration(ticks).count() / 1000.0; };
+
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	bool first = true;
+	for (uint32_t thread : threads)
+	{
+		auto nameIt = threadNames.find(thread);
+		std::string name = (nameIt != threadNames.end()) ? nameIt->second : "thread " + std::to_string(thread);
+
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+			<< ",\"args\":{\"name\":\"" << name << "\"}}";
+		first = false;
+	}
+
+	for (const ZoneEvent& event : events)
+	{
+		out << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+			<< ",\"ts\":" << toMicros(event.start - base) << ",\"dur\":" << toMicros(event.end - event.start);
+		if (event.jobID != NO_JOB)
+			out << ",\"args\":{\"job\":" << event.jobID << '}';
+		out << '}';
+		first = false;
+	}
+	out << "\n]}\n";
+}
+
+#if IMPLICIT_ENGINE_INSTRUMENTATION
+EventRing::EventRing()
+	: slots(capacity)
+{
+	// Calibrate up front rather than stalling the first zone
+	Instrumentation::TicksPerSecond();
+}
+
+void EventRing::Push(const ZoneEvent& event)
+{
+	uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+	Slot& slot = slots[index % capacity];
+
+	slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.name.store(event.name, std::memory_order_relaxed);
+	slot.jobID.store(event.jobID, std::memory_order_relaxed);
+	slot.start.store(event.start, std::memory_order_relaxed);
+	slot.end.store(event.end, std::memory_order_relaxed);
+	slot.thread.store(event.thread, std::memory_order_relaxed);
+
+	slot.seq.store(2 * index + 2, std::memory_order_release);
+}
+
+std::vector<ZoneEvent> EventRing::Snapshot() const
+{
+	uint64_t end = head.load(std::memory_order_acquire);
+	uint64_t begin = (end > capacity) ? end - capacity : 0;
+
+	std::vector<ZoneEvent> events;
+	events.reserve(end - begin);
+	for (uint64_t index = begin; index < end; index++)
+	{
+		const Slot& slot = slots[index % capacity];
+
+		// Skip slots still being written or already overwritten by a later event
+		uint64_t seq = slot.seq.load(std::memory_order_acquire);
+		if (seq != 2 * index + 2) continue;
+
+		ZoneEvent event = { slot.name.load(std::memory_order_relaxed), slot.jobID.load(std::memory_order_relaxed),
+			slot.start.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed), slot.thread.load(std::memory_order_relaxed) };
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+
+		events.push_back(event);
+	}
+	return events;
+}
+
+uint64_t EventRing::Pushed() const
+{
+	return head.load(std::memory_order_relaxed);
+}
+#else
+EventRing::EventRing() {}
+void EventRing::Push(const ZoneEvent&) {}
+std::vector<ZoneEvent> EventRing::Snapshot() const { return {}; }
+uint64_t EventRing::Pushed() const { return 0; }
+#endif
+
+void ScopedZone::End()
+{
+	if (ended) return;
+	ended = true;
+
+	uint64_t end = Instrumentation::Ticks();
+	if (counter)
+	{
+		*counter += Instrumentation::ToDuration(end - start);
+		Instrumentation::StageBoundary(name, false);
+	}
+	if (ring) ring->Push({ name, jobID, start, end, Instrumentation::ThreadIndex() });
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency)
+{
+	buckets[Bucket(latency)]++;
+	count++;
+	max = std::max(max, latency);
+}
+
+void LatencyHistogram::Reset()
+{
+	buckets = {};
+	count = 0;
+	max = std::chrono::nanoseconds(0);
+}
+
+uint64_t LatencyHistogram::Count() const
+{
+	return count;
+}
+
+std::chrono::nanoseconds LatencyHistogram::Percentile(double p) const
+{
+	if (count == 0) return std::chrono::nanoseconds(0);
+
+	uint64_t rank = std::min((uint64_t)(p * count), count - 1);
+	uint64_t seen = 0;
+	for (int bi = 0; bi < bucketNum; bi++)
+	{
+		seen += buckets[bi];
+		if (seen > rank) return std::min(BucketValue(bi), max);
+	}
+	return max;
+}
+
+std::chrono::nanoseconds LatencyHistogram::Max() const
+{
+	return max;
+}
+
+// Bucket 0 holds everything under 1us, bucket i covers [2^((i - 1) / n), 2^(i / n)) microseconds
+int LatencyHistogram::Bucket(std::chrono::nanoseconds latency)
+{
+	double micros = latency.count() / 1000.0;
+	if (micros < 1.0) return 0;
+	return std::min((int)(std::log2(micros) * bucketsPerDoubling) + 1, bucketNum - 1);
+}
+
+// Geometric centre of a bucket
+std::chrono::nanoseconds LatencyHistogram::BucketValue(int bucket)
+{
+	if (bucket == 0) return std::chrono::nanoseconds(500);
+	double micros = std::exp2((bucket - 0.5) / bucketsPerDoubling);
+	return std::chrono::nanoseconds((int64_t)(micros * 1000.0));
+}
\ No newline at end of file
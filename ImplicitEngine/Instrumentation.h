@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <map>
+#include <string>
+#include <ostream>
+#include <array>
+
+// Scoped timing zones recorded into a lock-free ring buffer. Building with
+// IMPLICIT_ENGINE_INSTRUMENTATION=0 turns zone macros into nothing, except that stage zones still time stages.
+#ifndef IMPLICIT_ENGINE_INSTRUMENTATION
+#define IMPLICIT_ENGINE_INSTRUMENTATION 1
+#endif
+
+// Job ID for zones which don't belong to a job
+constexpr size_t NO_JOB = SIZE_MAX;
+
+struct ZoneEvent
+{
+	const char* name; // Always a string literal
+	size_t jobID;
+	uint64_t start, end; // Ticks, see Instrumentation::TicksPerSecond
+	uint32_t thread; // Small per-thread index, not an OS thread ID
+};
+
+namespace Instrumentation
+{
+	// Timestamp counter on x86, steady clock nanoseconds elsewhere
+	uint64_t Ticks();
+	double TicksPerSecond();
+	std::chrono::nanoseconds ToDuration(uint64_t ticks);
+	uint32_t ThreadIndex();
+
+	// Called on the thread running a stage zone as it starts and ends, so tools can sample hardware
+	// counters per stage. Set it while no renderer is processing jobs, nullptr removes it.
+	typedef void (*StageHook)(const char* name, bool start);
+	void SetStageHook(StageHook hook);
+	void StageBoundary(const char* name, bool start);
+
+	// Writes events in the Chrome trace event format, loadable by chrome://tracing and Perfetto.
+	// Threads without a name in threadNames are labelled by their index.
+	void WriteChromeTrace(std::ostream& out, const std::vector<ZoneEvent>& events, const std::map<uint32_t, std::string>& threadNames);
+}
+
+// Fixed size multi-producer ring of zone events, old events are overwritten once it wraps.
+// Each slot carries a sequence number so readers can skip slots that are mid-write.
+class EventRing
+{
+public:
+	static constexpr size_t capacity = 8192;
+
+	EventRing();
+
+	void Push(const ZoneEvent& event);
+	std::vector<ZoneEvent> Snapshot() const;
+	uint64_t Pushed() const;
+
+protected:
+#if IMPLICIT_ENGINE_INSTRUMENTATION
+	struct Slot
+	{
+		std::atomic<uint64_t> seq{ 0 }; // 2 * index + 1 while writing, 2 * index + 2 once written
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<size_t> jobID{ 0 };
+		std::atomic<uint64_t> start{ 0 }, end{ 0 };
+		std::atomic<uint32_t> thread{ 0 };
+	};
+
+	std::vector<Slot> slots;
+	std::atomic<uint64_t> head{ 0 };
+#endif
+};
+
+// Log-spaced latency histogram from 1us to about 2 minutes, with 8 buckets per doubling so
+// percentiles are within about 5% of the true value
+class LatencyHistogram
+{
+public:
+	void Record(std::chrono::nanoseconds latency);
+	void Reset();
+
+	uint64_t Count() const;
+	std::chrono::nanoseconds Percentile(double p) const; // p in [0, 1]
+	std::chrono::nanoseconds Max() const;
+
+protected:
+	static constexpr int bucketsPerDoubling = 8;
+	static constexpr int doublings = 27;
+	static constexpr int bucketNum = bucketsPerDoubling * doublings + 1;
+
+	static int Bucket(std::chrono::nanoseconds latency);
+	static std::chrono::nanoseconds BucketValue(int bucket);
+
+	std::array<uint64_t, bucketNum> buckets{};
+	uint64_t count = 0;
+	std::chrono::nanoseconds max{ 0 };
+};
+
+// Records a zone from construction until End or destruction, optionally adding its duration to a counter
+class ScopedZone
+{
+public:
+	ScopedZone(EventRing* ring_, const char* name_, size_t jobID_, std::chrono::nanoseconds* counter_ = nullptr)
+		: ring(ring_), name(name_), jobID(jobID_), counter(counter_)
+	{
+		if (counter) Instrumentation::StageBoundary(name, true);
+		start = Instrumentation::Ticks();
+	}
+
+	~ScopedZone() { End(); }
+
+	ScopedZone(const ScopedZone&) = delete;
+	ScopedZone& operator=(const ScopedZone&) = delete;
+
+	void End();
+
+protected:
+	EventRing* ring;
+	const char* name;
+	size_t jobID;
+	std::chrono::nanoseconds* counter;
+	uint64_t start;
+	bool ended = false;
+};
+
+#if IMPLICIT_ENGINE_INSTRUMENTATION
+// ZONE(name, ring, jobID) times the rest of the scope as "name"
+#define ZONE(name, ring, jobID) ScopedZone zone_##name((ring), #name, (jobID))
+// STAGE_ZONE also adds the duration to timings->name, see StageTimings
+#define STAGE_ZONE(name, ring, jobID, timings) ScopedZone zone_##name((ring), #name, (jobID), &(timings)->name)
+#define END_ZONE(name) zone_##name.End()
+#else
+#define ZONE(name, ring, jobID) ((void)0)
+// Nothing is recorded, but StageTimings are still filled
+#define STAGE_ZONE(name, ring, jobID, timings) ScopedZone zone_##name(nullptr, #name, (jobID), &(timings)->name)
+#define END_ZONE(name) zone_##name.End()
+#endif
\ No newline at end of file
@@ -3,9 +3,12 @@
 
 wxBEGIN_EVENT_TABLE(Main, wxFrame)
 	EVT_MENU(20001, Main::OnMenuExit)
+	EVT_MENU(20002, Main::OnExportTrace)
+	EVT_MENU(20003, Main::OnInputLatency)
 	EVT_MENU(30001, Main::OnDisplayStandardOutput)
 	EVT_MENU(30002, Main::OnDisplaySeeds)
 	EVT_MENU(30003, Main::OnDisplayMesh)
+	EVT_MENU(30004, Main::OnDeterministic)
 	EVT_BUTTON(10002, Main::OnGearPressed)
 	EVT_BUTTON(10004, Main::OnHomePressed)
 	EVT_BUTTON(10005, Main::OnColWheelPressed)
@@ -19,11 +22,16 @@ Main::Main() : wxFrame(nullptr, wxID_ANY, "ImplicitEngine", wxPoint(30, 30), wxS
 	fileMenu = new wxMenu();
 	viewMenu = new wxMenu();
 
+	fileMenu->Append(20002, "Export Trace...");
+	fileMenu->Append(20003, "Input Latency...");
+	fileMenu->AppendSeparator();
 	fileMenu->Append(20001, "Exit\tAlt+F4");
 
 	viewMenu->Append(30001, "Standard Output")->SetCheckable(true);
 	viewMenu->Append(30002, "Prefiltering Seeds")->SetCheckable(true);
 	viewMenu->Append(30003, "Prefiltering Mesh")->SetCheckable(true);
+	viewMenu->AppendSeparator();
+	viewMenu->Append(30004, "Deterministic Rendering")->SetCheckable(true);
 	wxMenuItemList& menuItemList = viewMenu->GetMenuItems();
 	menuItemList[0]->Check(true);
 
@@ -93,9 +101,40 @@ void Main::OnMenuExit(wxCommandEvent&)
 	Destroy();
 }
 
+void Main::OnExportTrace(wxCommandEvent&)
+{
+	wxFileDialog dlg(this, "Export Trace", "", "trace.json", "Trace files (*.json)|*.json", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+	if (dlg.ShowModal() != wxID_OK) return;
+
+	std::ofstream out(dlg.GetPath().ToStdString());
+	if (!out) ErrorDialog("Could not write trace file");
+	else canvas->renderer->WriteChromeTrace(out);
+}
+
+void Main::OnInputLatency(wxCommandEvent&)
+{
+	static constexpr const char* sourceNames[] = { "Scroll", "Drag", "Equation edit" };
+
+	auto toMillis = [](std::chrono::nanoseconds latency) { return latency.count() / 1e6; };
+	auto describe = [&](std::string_view name, const LatencyHistogram& histogram)
+		{
+			return std::format("{}: {} frames, p50 {:.1f} ms, p95 {:.1f} ms, p99 {:.1f} ms, max {:.1f} ms\n", name, histogram.Count(),
+				toMillis(histogram.Percentile(0.5)), toMillis(histogram.Percentile(0.95)), toMillis(histogram.Percentile(0.99)), toMillis(histogram.Max()));
+		};
+
+	std::string text;
+	for (size_t si = 0; si < (size_t)InputSource::COUNT; si++)
+		text += describe(sourceNames[si], canvas->GetInputLatency((InputSource)si));
+	text += describe("All input", canvas->GetInputLatency());
+
+	wxMessageDialog dlg(this, text, "Input to Present Latency", wxYES_NO | wxNO_DEFAULT);
+	dlg.SetYesNoLabels("Reset", "Close");
+	if (dlg.ShowModal() == wxID_YES) canvas->ResetInputLatency();
+}
+
 void Main::OnGearPressed(wxCommandEvent&)
 {
-	wxDialog* dialog = new wxDialog(this, wxID_ANY, "Advanced Render Settings", wxDefaultPosition, wxSize(305, 135));
+	wxDialog* dialog = new wxDialog(this, wxID_ANY, "Advanced Render Settings", wxDefaultPosition, wxSize(305, 195));
 	wxPanel* dialogPanel = new wxPanel(dialog);
 	dialogPanel->SetFocus();
 
@@ -110,7 +149,7 @@ void Main::OnGearPressed(wxCommandEvent&)
 
 	new wxStaticText(dialogPanel, wxID_ANY, "Prefiltering Resolution", wxPoint(10, 38));
 	prefResSpinner = new wxSpinCtrl(dialogPanel, wxID_ANY, "", wxPoint(140, 35), wxSize(65, 25),
-		wxALIGN_LEFT | wxSP_ARROW_KEYS, 2, 8, canvas->renderer->GetFilterMeshRes());
+		wxALIGN_LEFT | wxSP_ARROW_KEYS, 2, canvas->renderer->GetFinalMeshRes(), canvas->renderer->GetFilterMeshRes());
 
 	new wxStaticText(dialogPanel, wxID_ANY, "Final Mesh Resolution", wxPoint(10, 68));
 	finalResSpinner = new wxSpinCtrl(dialogPanel, wxID_ANY, "", wxPoint(140, 65), wxSize(65, 25),
@@ -148,6 +187,23 @@ void Main::OnGearPressed(wxCommandEvent&)
 			finalResSpinner->SetMin(prefResSpinner->GetValue());
 		});
 
+	// Adaptive seed budget
+	wxCheckBox* adaptSeedsBox = new wxCheckBox(dialogPanel, wxID_ANY, "Adapt seeds per equation", wxPoint(10, 98));
+	adaptSeedsBox->SetToolTip("Adjust each equation's number of seeds from the results of its previous frame");
+	adaptSeedsBox->SetValue(adaptSeedNum);
+	adaptSeedsBox->Bind(wxEVT_CHECKBOX, [this](wxCommandEvent& evt)
+		{
+			adaptSeedNum = evt.IsChecked();
+			canvas->renderer->AdaptSeedNum(adaptSeedNum);
+		});
+
+	// Memory budget, in megabytes so the spinner's int range covers it
+	new wxStaticText(dialogPanel, wxID_ANY, "Memory Budget (MB)", wxPoint(10, 128));
+	wxSpinCtrl* budgetSpinner = new wxSpinCtrl(dialogPanel, wxID_ANY, "", wxPoint(140, 125), wxSize(65, 25),
+		wxALIGN_LEFT | wxSP_ARROW_KEYS, 0, 65536, (int)(canvas->renderer->GetMemoryBudget() >> 20));
+	budgetSpinner->SetToolTip("Lower the resolution of the largest equations to keep their memory under this, 0 for no limit");
+	budgetSpinner->Bind(wxEVT_SPINCTRL, [this](wxSpinEvent& evt) { canvas->renderer->SetMemoryBudget((size_t)evt.GetValue() << 20); });
+
 	dialog->ShowModal();
 }
 
@@ -181,7 +237,7 @@ void Main::OnColWheelPressed(wxCommandEvent&)
 			if (selection != wxNOT_FOUND)
 			{
 				size_t eqnID = equationList->GetListCtrl()->GetItemData(selection);
-				clrPicker->SetColour(canvas->renderer->GetJobColour(eqnID));
+				clrPicker->SetColour(canvas->GetJobColour(eqnID));
 			}
 		});
 
@@ -195,7 +251,7 @@ void Main::OnColWheelPressed(wxCommandEvent&)
 			else
 			{
 				size_t eqnID = equationList->GetListCtrl()->GetItemData(selection);
-				canvas->renderer->SetJobColor(eqnID, clrPicker->GetColour());
+				canvas->SetJobColour(eqnID, clrPicker->GetColour());
 				dlg->Destroy();
 			}
 		});
@@ -218,8 +274,15 @@ void Main::OnDisplayMesh(wxCommandEvent& evt)
 	canvas->DisplayMeshes(evt.IsChecked());
 }
 
+void Main::OnDeterministic(wxCommandEvent& evt)
+{
+	canvas->renderer->SetDeterministic(evt.IsChecked());
+}
+
 void Main::OnEquationEdit(wxListEvent& evt)
 {
+	InputStamp input = { Instrumentation::Ticks(), InputSource::EQUATION_EDIT };
+
 	int i = evt.GetIndex();
 	size_t data = equationList->GetListCtrl()->GetItemData(i);
 	if (!data)
@@ -233,7 +296,7 @@ void Main::OnEquationEdit(wxListEvent& evt)
 
 		bool strValid = true;
 		std::string funcStr = ProcessEquationString(eqnStr, &strValid);
-		bool compValid = canvas->renderer->NewJob(funcStr, canvas->bounds, id, strValid);
+		bool compValid = canvas->renderer->NewJob(funcStr, canvas->bounds, id, strValid, nullptr, input);
 
 		if (!compValid) ErrorDialog("Mathematical Syntax Error");
 	}
@@ -246,7 +309,7 @@ void Main::OnEquationEdit(wxListEvent& evt)
 
 		bool strValid = true;
 		std::string funcStr = ProcessEquationString(eqnStr, &strValid);
-		bool compValid = canvas->renderer->EditJob(id, funcStr, strValid);
+		bool compValid = canvas->renderer->EditJob(id, funcStr, strValid, input);
 
 		if (!compValid) ErrorDialog("Mathematical Syntax Error");
 	}
@@ -256,7 +319,8 @@ void Main::OnEquationEdit(wxListEvent& evt)
 void Main::OnEquationDelete(wxListEvent& evt)
 {
 	canvas->renderer->DeleteJob(evt.GetData());
-	canvas->Refresh();
+	canvas->jobColours.erase(evt.GetData());
+	canvas->RequestRepaint();
 	evt.Skip();
 }
 
@@ -9,6 +9,7 @@
 #pragma warning(pop)
 
 #include <sstream>
+#include <fstream>
 #include <atomic>
 
 #include "icons.h"
@@ -25,6 +26,8 @@ public:
 protected:
 
 	void OnMenuExit(wxCommandEvent& evt);
+	void OnExportTrace(wxCommandEvent& evt);
+	void OnInputLatency(wxCommandEvent& evt);
 	void OnGearPressed(wxCommandEvent& evt);
 	void OnHomePressed(wxCommandEvent& evt);
 	void OnColWheelPressed(wxCommandEvent& evt);
@@ -32,6 +35,7 @@ protected:
 	void OnDisplayStandardOutput(wxCommandEvent& evt);
 	void OnDisplaySeeds(wxCommandEvent& evt);
 	void OnDisplayMesh(wxCommandEvent& evt);
+	void OnDeterministic(wxCommandEvent& evt);
 
 	void OnEquationEdit(wxListEvent& evt);
 	void OnEquationDelete(wxListEvent& evt);
@@ -62,6 +66,7 @@ protected:
 	wxButton* colBtn = nullptr;
 
 	std::atomic<size_t> nextEqnID = 15000;
+	bool adaptSeedNum = true;
 
 	// Canvas
 	bool useAntialiasing = true;
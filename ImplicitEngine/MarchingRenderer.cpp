@@ -1,7 +1,7 @@
 #include "MarchingRenderer.h"
 
-MarchingRenderer::MarchingRenderer(CallbackFun refreshFun, int finalMeshRes_)
-	: Renderer(refreshFun), finalMeshRes(finalMeshRes_), pool(std::thread::hardware_concurrency() - 1) {}
+MarchingRenderer::MarchingRenderer(CallbackFun refreshFun, int finalMeshRes_, int threadNum)
+	: Renderer(refreshFun), finalMeshRes(finalMeshRes_), frameMeshRes(finalMeshRes_), pool(threadNum) {}
 
 void MarchingRenderer::SetFinalMeshRes(int value)
 {
@@ -13,28 +13,43 @@ int MarchingRenderer::GetFinalMeshRes()
 	return finalMeshRes;
 }
 
+int MarchingRenderer::MaxResolutionDrop()
+{
+	return std::clamp(finalMeshRes - 1, 0, maxResolutionDrop);
+}
+
 void MarchingRenderer::ProcessJob(Job* job)
 {
-	Timer frameTimer;
+	frameMeshRes = std::max(finalMeshRes - job->resolutionDrop, 1);
+
+	job->timings = {};
+	job->funcs.ResetEvalCounts();
+	ZONE(frame, &events, job->id);
 	DoProcessJobMulti(job);
-	frameTimer.Stop(false);
-	std::cout << frameTimer.GetDuration().count() << '\n';
+
+	uint64_t gridDim = Pow2(frameMeshRes) + 1;
+	job->evals = job->funcs.GetEvalCounts();
+	job->evals.gridSamples = gridDim * gridDim;
 }
 
 void MarchingRenderer::DoProcessJobSingle(Job* job)
 {
 	Bounds bounds = job->bounds;
 	Function& func = *(job->funcs[0]);
-	job->verts.clear();
+	func.SetEvalStage(EvalStage::ROW_FILL);
+	job->ResetVerts(bounds);
 
-	size_t finalMeshDim = Pow2(finalMeshRes);
+	size_t finalMeshDim = Pow2(frameMeshRes);
 	double squareW = bounds.w() / finalMeshDim;
 	double squareH = bounds.h() / finalMeshDim;
+	double x0 = bounds.xmin - job->xOrigin;
+	double y0 = bounds.ymin - job->yOrigin;
 	std::vector<double> downBuf(finalMeshDim + 1), upBuf(finalMeshDim + 1);
 
 	for (size_t y = 0; y <= finalMeshDim; y++)
 	{
 		double worldY = bounds.ymin + bounds.h() * y / finalMeshDim;
+		double localY = y0 + bounds.h() * y / finalMeshDim;
 		for (size_t x = 0; x <= finalMeshDim; x++)
 		{
 			double worldX = bounds.xmin + bounds.w() * x / finalMeshDim;
@@ -42,10 +57,10 @@ void MarchingRenderer::DoProcessJobSingle(Job* job)
 
 			if (x > 1 && y > 1)
 			{
-				double lx = worldX - squareW;
-				double rx = worldX;
-				double ty = worldY;
-				double by = worldY - squareH;
+				double rx = x0 + bounds.w() * x / finalMeshDim;
+				double lx = rx - squareW;
+				double ty = localY;
+				double by = localY - squareH;
 
 				double xs[4] = { lx, rx, rx, lx };
 				double ys[4] = { ty, ty, by, by };
@@ -54,8 +69,8 @@ void MarchingRenderer::DoProcessJobSingle(Job* job)
 
 				for (int vi = 0; vi < lines.n * 2; vi++)
 				{
-					job->verts.push_back(lines.xs[vi]);
-					job->verts.push_back(lines.ys[vi]);
+					job->verts.push_back((float)lines.xs[vi]);
+					job->verts.push_back((float)lines.ys[vi]);
 				}
 			}
 		}
@@ -68,7 +83,7 @@ void MarchingRenderer::DoProcessJobMulti(Job* job)
 	Bounds bounds = job->bounds;
 
 	// Calculate which regions of the image to dedicate to each thread
-	size_t finalMeshDim = Pow2(finalMeshRes);
+	size_t finalMeshDim = Pow2(frameMeshRes);
 	int threadNum = pool.get_thread_count();
 	job->funcs.Resize(threadNum + 1);
 
@@ -82,6 +97,7 @@ void MarchingRenderer::DoProcessJobMulti(Job* job)
 	endRows.back() = finalMeshDim;
 
 	// First compute the values on the boundaries of the thread areas
+	STAGE_ZONE(fill, &events, job->id, &job->timings);
 	std::vector<std::vector<double>> boundaries(threadNum + 1);
 
 	std::vector<std::future<void>> futs;
@@ -91,14 +107,23 @@ void MarchingRenderer::DoProcessJobMulti(Job* job)
 
 		auto outPtr = &boundaries[i];
 		auto funcPtr = job->funcs[i];
-		futs.push_back(pool.submit([=, this]() { this->FillBuffer(outPtr, y, &bounds, finalMeshDim, funcPtr); }));
+		futs.push_back(pool.submit([=, this]()
+			{
+				ZONE(fill_boundary, &events, job->id);
+				funcPtr->SetEvalStage(EvalStage::BOUNDARY_FILL);
+				this->FillBuffer(outPtr, y, &bounds, finalMeshDim, funcPtr);
+			}));
 	}
 
 	for (auto& fut : futs)
 		fut.wait();
+	END_ZONE(fill);
 
 	// Boundary values have been calculated, dispatch threads on blocks
-	std::vector<std::vector<double>> blockVerts(threadNum);
+	STAGE_ZONE(contour, &events, job->id, &job->timings);
+	std::vector<std::vector<float>> blockVerts(threadNum);
+	job->ResetVerts(bounds);
+	double xOrigin = job->xOrigin, yOrigin = job->yOrigin;
 
 	futs.clear();
 	for (int ti = 0; ti < threadNum; ti++)
@@ -108,20 +133,25 @@ void MarchingRenderer::DoProcessJobMulti(Job* job)
 
 		auto bottom = &boundaries[ti];
 		auto top = &boundaries[ti + 1];
-		futs.push_back(pool.submit([=, this]() { this->ContourRows(outPtr, startRows[ti], endRows[ti], &bounds, funcPtr, bottom, top); }));
+		futs.push_back(pool.submit([=, this]()
+			{
+				ZONE(contour_band, &events, job->id);
+				this->ContourRows(outPtr, xOrigin, yOrigin, startRows[ti], endRows[ti], &bounds, funcPtr, bottom, top);
+			}));
 	}
 
 	for (auto& fut : futs)
 		fut.wait();
+	END_ZONE(contour);
 
 	// Collect verts into one vec
-	job->verts.clear();
-
+	STAGE_ZONE(collect, &events, job->id, &job->timings);
 	for (auto& vec : blockVerts)
-	{
-		for (double val : vec)
-			job->verts.push_back(val);
-	}
+		job->verts.insert(job->verts.end(), vec.begin(), vec.end());
+
+	job->memory.transient = 0;
+	for (const auto& vec : blockVerts) job->memory.transient += vec.capacity() * sizeof(float);
+	for (const auto& vec : boundaries) job->memory.transient += vec.capacity() * sizeof(double);
 }
 
 void MarchingRenderer::FillBuffer(std::vector<double>* buf, size_t y, const Bounds* boundsPtr, size_t finalMeshDim, Function* funcPtr)
@@ -133,27 +163,33 @@ void MarchingRenderer::FillBuffer(std::vector<double>* buf, size_t y, const Boun
 	const Bounds& bounds = *boundsPtr;
 
 	double worldY = bounds.ymin + (double)y / finalMeshDim * bounds.h();
-	for (size_t x = 0; x < finalMeshDim; x++)
+	for (size_t x = 0; x <= finalMeshDim; x++)
 	{
 		double worldX = bounds.xmin + (double)x / finalMeshDim * bounds.w();
 		(*buf)[x] = func(worldX, worldY);
 	}
 }
 
-void MarchingRenderer::ContourRows(std::vector<double>* verts, size_t startY, size_t endY, const Bounds* boundsPtr, Function* funcPtr, const std::vector<double>* bottom, const std::vector<double>* top)
+void MarchingRenderer::ContourRows(std::vector<float>* verts, double xOrigin, double yOrigin, size_t startY, size_t endY, const Bounds* boundsPtr, Function* funcPtr, const std::vector<double>* bottom, const std::vector<double>* top)
 {
 	Function& func = *funcPtr;
+	func.SetEvalStage(EvalStage::ROW_FILL);
 	const Bounds& bounds = *boundsPtr;
 
-	size_t finalMeshDim = Pow2(finalMeshRes);
+	size_t finalMeshDim = Pow2(frameMeshRes);
 	double squareW = bounds.w() / finalMeshDim;
 	double squareH = bounds.h() / finalMeshDim;
 
+	// Vertices are placed relative to the origin rather than offset from world coordinates
+	double x0 = bounds.xmin - xOrigin;
+	double y0 = bounds.ymin - yOrigin;
+
 	std::vector<double> upBuf(finalMeshDim + 1), downBuf = *bottom;
 
 	for (size_t y = startY + 1; y <= endY; y++)
 	{
 		double worldY = bounds.ymin + (double)y / finalMeshDim * bounds.h();
+		double localY = y0 + (double)y / finalMeshDim * bounds.h();
 
 		for (size_t x = 0; x <= finalMeshDim; x++)
 		{
@@ -172,10 +208,10 @@ void MarchingRenderer::ContourRows(std::vector<double>* verts, size_t startY, si
 			if (x > 0)
 			{
 				// Compute verticies for this square
-				double lx = worldX - squareW;
-				double rx = worldX;
-				double ty = worldY;
-				double by = worldY - squareH;
+				double rx = x0 + (double)x / finalMeshDim * bounds.w();
+				double lx = rx - squareW;
+				double ty = localY;
+				double by = localY - squareH;
 
 				double xs[4] = { lx, rx, rx, lx };
 				double ys[4] = { ty, ty, by, by };
@@ -184,8 +220,8 @@ void MarchingRenderer::ContourRows(std::vector<double>* verts, size_t startY, si
 
 				for (int vi = 0; vi < lines.n * 2; vi++)
 				{
-					verts->push_back(lines.xs[vi]);
-					verts->push_back(lines.ys[vi]);
+					verts->push_back((float)lines.xs[vi]);
+					verts->push_back((float)lines.ys[vi]);
 				}
 			}
 		}
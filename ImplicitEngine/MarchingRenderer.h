@@ -4,7 +4,7 @@
 class MarchingRenderer : public Renderer
 {
 public:
-	MarchingRenderer(CallbackFun refreshFun, int finalMeshRes_ = 9);
+	MarchingRenderer(CallbackFun refreshFun, int finalMeshRes_ = 9, int threadNum = DefaultThreadNum());
 
 	void SetFinalMeshRes(int value);
 	int GetFinalMeshRes();
@@ -12,22 +12,26 @@ public:
 	// For parity with filtering renderer
 	void KeepMesh(bool) {}
 	void KeepSeeds(bool) {}
+	void AdaptSeedNum(bool) {}
 	int GetSeedNum() { return 0; };
 	int GetFilterMeshRes() { return 0; };
 	void SetSeedNum(int) {};
 	void SetFilterMeshRes(int) {};
 	std::optional<std::shared_ptr<Seeds>> GetSeeds(size_t) { return {}; };
 	std::optional<std::shared_ptr<Mesh>> GetMesh(size_t) { return {}; };
+	std::optional<SeedStats> GetSeedStats(size_t) { return {}; };
 
 protected:
 	void ProcessJob(Job* job);
+	int MaxResolutionDrop();
 	void DoProcessJobSingle(Job* job);
 	void DoProcessJobMulti(Job* job);
 
 	void FillBuffer(std::vector<double>* buf, size_t y, const Bounds* boundsPtr, size_t finalMeshDim, Function* funcPtr);
-	void ContourRows(std::vector<double>* verts, size_t startY, size_t endY, const Bounds* boundsPtr, Function* funcPtr, const std::vector<double>* bottom, const std::vector<double>* top);
+	void ContourRows(std::vector<float>* verts, double xOrigin, double yOrigin, size_t startY, size_t endY, const Bounds* boundsPtr, Function* funcPtr, const std::vector<double>* bottom, const std::vector<double>* top);
 	Lines GetTileLines(double* xs, double* ys, double* vals) const;
 
 	int finalMeshRes;
+	int frameMeshRes; // Final mesh resolution of the frame being rendered, lowered under a memory budget
 	BS::thread_pool pool;
 };
\ No newline at end of file
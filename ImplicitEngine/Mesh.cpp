@@ -0,0 +1,221 @@
+#include "Mesh.h"
+
+#include <atomic>
+#include <bit>
+#include <algorithm>
+
+Mesh::Mesh(int res)
+{
+	Reset(res);
+}
+
+void Mesh::Reset(int res_)
+{
+	res = res_;
+	dim = (int)Pow2(res);
+	rowWords = (dim + 63) / 64;
+	boxes.assign((size_t)rowWords * dim, 0);
+}
+
+bool Mesh::Get(int x, int y) const
+{
+	return (boxes[(size_t)y * rowWords + x / 64] >> (x % 64)) & 1;
+}
+
+void Mesh::Set(int x, int y)
+{
+	std::atomic_ref<uint64_t> word(boxes[(size_t)y * rowWords + x / 64]);
+	word.fetch_or((uint64_t)1 << (x % 64), std::memory_order_relaxed);
+}
+
+bool Mesh::GetConcurrent(int x, int y)
+{
+	std::atomic_ref<uint64_t> word(boxes[(size_t)y * rowWords + x / 64]);
+	return (word.load(std::memory_order_relaxed) >> (x % 64)) & 1;
+}
+
+bool Mesh::TrySet(int x, int y)
+{
+	std::atomic_ref<uint64_t> word(boxes[(size_t)y * rowWords + x / 64]);
+	uint64_t bit = (uint64_t)1 << (x % 64);
+	return word.fetch_or(bit, std::memory_order_relaxed) & bit;
+}
+
+size_t Mesh::Count() const
+{
+	size_t count = 0;
+	for (uint64_t word : boxes)
+		count += std::popcount(word);
+
+	return count;
+}
+
+void Mesh::Dilate(const Mesh& centres)
+{
+	// Enable every box which is, or is directly adjacent to, a box in 'centres'
+	for (int y = 0; y < dim; y++)
+	{
+		const uint64_t* row = &centres.boxes[(size_t)y * rowWords];
+		const uint64_t* below = (y > 0) ? row - rowWords : nullptr;
+		const uint64_t* above = (y < dim - 1) ? row + rowWords : nullptr;
+		uint64_t* out = &boxes[(size_t)y * rowWords];
+
+		for (int wi = 0; wi < rowWords; wi++)
+		{
+			uint64_t c = row[wi];
+			uint64_t fromLeft = (c << 1) | ((wi > 0) ? row[wi - 1] >> 63 : 0);
+			uint64_t fromRight = (c >> 1) | ((wi < rowWords - 1) ? row[wi + 1] << 63 : 0);
+
+			uint64_t dilated = c | fromLeft | fromRight;
+			if (below) dilated |= below[wi];
+			if (above) dilated |= above[wi];
+
+			out[wi] |= dilated & RowMask(wi);
+		}
+	}
+}
+
+void Mesh::BuildIndex()
+{
+	// Spans of each row, and of each pair of adjacent rows
+	rowSpans.resize(dim);
+	edgeSpans.resize(dim);
+
+	std::vector<uint64_t> pairRow(rowWords);
+	for (int y = 0; y < dim; y++)
+	{
+		const uint64_t* row = &boxes[(size_t)y * rowWords];
+		ExtractSpans(row, &rowSpans[y]);
+
+		if (y < dim - 1)
+		{
+			for (int wi = 0; wi < rowWords; wi++)
+				pairRow[wi] = row[wi] | row[wi + rowWords];
+			ExtractSpans(pairRow.data(), &edgeSpans[y]);
+		}
+		else edgeSpans[y] = rowSpans[y];
+	}
+
+	// Occupancy pyramid, each node reduces a 2x2 block of the level below
+	pyramid.resize(res + 1);
+	for (int level = 1; level <= res; level++)
+	{
+		int levelDim = dim >> level;
+		pyramid[level].resize((size_t)levelDim * levelDim);
+
+		for (int ny = 0; ny < levelDim; ny++)
+		{
+			for (int nx = 0; nx < levelDim; nx++)
+			{
+				uint8_t any = 0, all = NODE_ALL;
+				for (int cy = 0; cy < 2; cy++)
+				{
+					for (int cx = 0; cx < 2; cx++)
+					{
+						uint8_t child = Node(level - 1, nx * 2 + cx, ny * 2 + cy);
+						any |= child & NODE_ANY;
+						all &= child & NODE_ALL;
+					}
+				}
+				pyramid[level][(size_t)ny * levelDim + nx] = any | all;
+			}
+		}
+	}
+}
+
+const std::vector<Span>& Mesh::RowSpans(int y) const
+{
+	return rowSpans[y];
+}
+
+const std::vector<Span>& Mesh::EdgeSpans(int y) const
+{
+	return edgeSpans[y];
+}
+
+bool Mesh::AnyActive(int x0, int y0, int x1, int y1) const
+{
+	x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+	x1 = std::min(x1, dim); y1 = std::min(y1, dim);
+	if (x0 >= x1 || y0 >= y1) return false;
+
+	return AnyActiveNode(res, 0, 0, x0, y0, x1, y1);
+}
+
+size_t Mesh::MemoryBytes() const
+{
+	size_t bytes = boxes.capacity() * sizeof(uint64_t);
+	for (const auto& spans : rowSpans) bytes += spans.capacity() * sizeof(Span);
+	for (const auto& spans : edgeSpans) bytes += spans.capacity() * sizeof(Span);
+	for (const auto& level : pyramid) bytes += level.capacity();
+	return bytes + (rowSpans.capacity() + edgeSpans.capacity() + pyramid.capacity()) * sizeof(std::vector<Span>);
+}
+
+uint64_t Mesh::RowMask(int wordIndex) const
+{
+	// Clear the padding bits past the end of a row
+	int bitsInWord = dim - wordIndex * 64;
+	return (bitsInWord >= 64) ? UINT64_MAX : (((uint64_t)1 << bitsInWord) - 1);
+}
+
+int Mesh::NextBit(const uint64_t* row, int x, bool value) const
+{
+	// Position of the next bit equal to 'value' at or after x, or dim if there is none
+	while (x < dim)
+	{
+		int wi = x / 64;
+		uint64_t word = (value ? row[wi] : ~row[wi]) & (UINT64_MAX << (x % 64));
+		if (word) return std::min(wi * 64 + std::countr_zero(word), dim);
+
+		x = (wi + 1) * 64;
+	}
+	return dim;
+}
+
+void Mesh::ExtractSpans(const uint64_t* row, std::vector<Span>* spans) const
+{
+	spans->clear();
+
+	int x = NextBit(row, 0, true);
+	while (x < dim)
+	{
+		int end = NextBit(row, x, false);
+		spans->push_back({ x, end });
+		x = NextBit(row, end, true);
+	}
+}
+
+uint8_t Mesh::Node(int level, int nx, int ny) const
+{
+	if (level == 0)
+		return Get(nx, ny) ? (NODE_ANY | NODE_ALL) : 0;
+
+	return pyramid[level][(size_t)ny * (dim >> level) + nx];
+}
+
+bool Mesh::AnyActiveNode(int level, int nx, int ny, int x0, int y0, int x1, int y1) const
+{
+	int size = 1 << level;
+	int bx0 = nx * size, by0 = ny * size;
+	int bx1 = bx0 + size, by1 = by0 + size;
+
+	// Node outside the query
+	if (bx1 <= x0 || bx0 >= x1 || by1 <= y0 || by0 >= y1) return false;
+
+	uint8_t node = Node(level, nx, ny);
+	if (!(node & NODE_ANY)) return false;
+	if (node & NODE_ALL) return true;
+
+	// Node fully inside the query
+	if (bx0 >= x0 && bx1 <= x1 && by0 >= y0 && by1 <= y1) return true;
+
+	for (int cy = 0; cy < 2; cy++)
+	{
+		for (int cx = 0; cx < 2; cx++)
+		{
+			if (AnyActiveNode(level - 1, nx * 2 + cx, ny * 2 + cy, x0, y0, x1, y1))
+				return true;
+		}
+	}
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Bounds.h"
+#include "pow4.h"
+
+// Half-open run [start, end) of active boxes within a row
+struct Span
+{
+	int start, end;
+};
+
+// Bit-packed square grid of filter boxes, stored row by row with each row padded to a whole number of words
+struct Mesh
+{
+	Mesh(int res);
+
+	void Reset(int res);
+	bool Get(int x, int y) const;
+	void Set(int x, int y); // Thread-safe, may be called concurrently on the same mesh
+	bool GetConcurrent(int x, int y); // Get which is safe to call alongside concurrent 'Set' calls
+	bool TrySet(int x, int y); // Thread-safe Set returning whether the box was already set
+	size_t Count() const;
+	void Dilate(const Mesh& centres);
+
+	// Builds the row spans and occupancy pyramid, must be called after the boxes are final
+	void BuildIndex();
+	const std::vector<Span>& RowSpans(int y) const;
+	const std::vector<Span>& EdgeSpans(int y) const; // Boxes active in row y or y + 1
+	bool AnyActive(int x0, int y0, int x1, int y1) const; // Half-open rectangle of boxes
+
+	size_t MemoryBytes() const; // Boxes plus the index
+
+	int res;
+	int dim;
+	int rowWords;
+	std::vector<uint64_t> boxes;
+	Bounds bounds = { 0.0, 0.0, 0.0, 0.0 };
+
+protected:
+	// Pyramid node flags, 'any' is the max and 'all' the min over the node's boxes
+	static constexpr uint8_t NODE_ANY = 1;
+	static constexpr uint8_t NODE_ALL = 2;
+
+	uint64_t RowMask(int wordIndex) const;
+	int NextBit(const uint64_t* row, int x, bool value) const;
+	void ExtractSpans(const uint64_t* row, std::vector<Span>* spans) const;
+	uint8_t Node(int level, int nx, int ny) const;
+	bool AnyActiveNode(int level, int nx, int ny, int x0, int y0, int x1, int y1) const;
+
+	std::vector<std::vector<Span>> rowSpans, edgeSpans;
+	std::vector<std::vector<uint8_t>> pyramid; // pyramid[level] has nodes of 2^level x 2^level boxes, level 0 is unused
+};
\ No newline at end of file
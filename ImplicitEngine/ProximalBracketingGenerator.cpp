@@ -1,25 +1,22 @@
 #include "ProximalBracketingGenerator.h"
 
-void ProximalBracketingGenerator::Generate(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, int maxEval, int filterMeshRes, int seedNum)
+bool ProximalBracketingGenerator::Generate(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, int maxEval, int filterMeshRes, int seedNum, uint32_t rngSeed)
+{
+	return Generate(seeds, funcPtr, bounds, bounds.Expand(BOUNDS_EXPANSION), maxEval, filterMeshRes, seedNum, rngSeed);
+}
+
+bool ProximalBracketingGenerator::Generate(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, Bounds sampleBounds, int maxEval, int filterMeshRes, int seedNum, uint32_t rngSeed)
 {
 	// Parameters
-	static constexpr double boundsExpansion = 1.1;
 	static constexpr double finiteDifRatio = 1e-10;
-	static constexpr size_t signChangeThresh = 1;
+	static constexpr int signChangeThresh = 1;
 	static constexpr double newtOverstep = 1.1;
-	static constexpr double tomsThreshold = 1000.0;
-	static constexpr uint64_t maxTomsIter = 16;
 
 	Function& func = *funcPtr;
 
-	// Initialize random number generation
-	std::random_device rd;
-	std::mt19937 mt(rd());
-	std::uniform_int_distribution<unsigned> distribution(0, UINT32_MAX);
-	srand(distribution(mt));
-
-	double w = bounds.w();
-	double h = bounds.h();
+	// Initialize random number generation, local to this call so results only depend on 'rngSeed'
+	std::mt19937 mt(rngSeed);
+	std::uniform_real_distribution<double> distribution(0.0, 1.0);
 
 	// Initialize seed lists
 	std::vector<Seed> unBracketedSeeds;
@@ -28,13 +25,14 @@ void ProximalBracketingGenerator::Generate(std::vector<Seed>* seeds, Function* f
 
 	int posNum = 0, negNum = 0;
 
-	Bounds exBounds = bounds.Expand(boundsExpansion);
-
 	// Randomly position seeds, evaluate, and add to vec
+	func.SetEvalStage(EvalStage::SEED_PLACEMENT);
 	for (int i = 0; i < seedNum; i++)
 	{
-		Seed s = { exBounds.xmin + w * boundsExpansion * (double)rand() / RAND_MAX,
-			exBounds.ymin + h * boundsExpansion * (double)rand() / RAND_MAX };
+		double rx = distribution(mt);
+		double ry = distribution(mt);
+		Seed s = { sampleBounds.xmin + sampleBounds.w() * rx,
+			sampleBounds.ymin + sampleBounds.h() * ry };
 
 		s.fs = func(s.x, s.y);
 		if (std::isfinite(s.fs))
@@ -49,6 +47,7 @@ void ProximalBracketingGenerator::Generate(std::vector<Seed>* seeds, Function* f
 	// Find oppositely signed points
 	int maxNewtIter = maxEval / 3;
 	int newtIter = 0;
+	func.SetEvalStage(EvalStage::NEWTON);
 	while (std::min(posNum, negNum) < signChangeThresh && newtIter < maxNewtIter)
 	{
 		// No sign flips, performing newton
@@ -77,7 +76,7 @@ void ProximalBracketingGenerator::Generate(std::vector<Seed>* seeds, Function* f
 	}
 
 	// If no sign changes found, generation failed
-	if (std::min(posNum, negNum) == 0) return;
+	if (std::min(posNum, negNum) == 0) return false;
 
 	// Proximity bracketing
 	// Separate seeds into pos and neg
@@ -135,24 +134,130 @@ void ProximalBracketingGenerator::Generate(std::vector<Seed>* seeds, Function* f
 		bracketedSeeds.push_back({ *s1, s2 });
 	}
 
-	double absTol = std::min(w, h) / tomsThreshold;
-
 	// Perform bracketed refinement
+	func.SetEvalStage(EvalStage::REFINEMENT);
 	for (auto& [s1, s2] : bracketedSeeds)
+		seeds->push_back(Refine(func, s1, s2, bounds, filterMeshRes));
+
+	return true;
+}
+
+void ProximalBracketingGenerator::GridScan(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, Bounds sampleBounds, int gridRes, int rowStart, int rowEnd, int filterMeshRes)
+{
+	Function& func = *funcPtr;
+	func.SetEvalStage(EvalStage::FALLBACK);
+	int gridDim = (int)Pow2(gridRes);
+
+	// Evaluate grid nodes row by row, bracketing along every edge whose ends differ in sign. Node row rowEnd is
+	// needed for the vertical edges, but its horizontal edges belong to the next lane unless it's the top row.
+	std::vector<Seed> downRow(gridDim + 1), upRow(gridDim + 1);
+	for (int gy = rowStart; gy <= rowEnd; gy++)
+	{
+		bool ownsRow = gy < rowEnd || rowEnd == gridDim;
+		double worldY = sampleBounds.ymin + sampleBounds.h() * gy / gridDim;
+		for (int gx = 0; gx <= gridDim; gx++)
+		{
+			Seed& s = upRow[gx];
+			s = { sampleBounds.xmin + sampleBounds.w() * gx / gridDim, worldY };
+			s.fs = func(s.x, s.y);
+			s.active = std::isfinite(s.fs);
+
+			// Horizontal edge
+			const Seed& left = upRow[gx - (gx > 0)];
+			if (ownsRow && gx > 0 && s.active && left.active && (s.fs < 0) != (left.fs < 0))
+				seeds->push_back(Refine(func, left, s, bounds, filterMeshRes));
+
+			// Vertical edge
+			const Seed& below = downRow[gx];
+			if (gy > rowStart && s.active && below.active && (s.fs < 0) != (below.fs < 0))
+				seeds->push_back(Refine(func, below, s, bounds, filterMeshRes));
+		}
+		std::swap(downRow, upRow);
+	}
+}
+
+void ProximalBracketingGenerator::Subdivide(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, Bounds sampleBounds, int gridRes, int rowStart, int rowEnd, int maxDepth, int filterMeshRes, int64_t* evalBudget)
+{
+	Function& func = *funcPtr;
+	func.SetEvalStage(EvalStage::FALLBACK);
+	int gridDim = (int)Pow2(gridRes);
+	double cellW = sampleBounds.w() / gridDim;
+	double cellH = sampleBounds.h() / gridDim;
+
+	for (int gy = rowStart; gy < rowEnd; gy++)
 	{
-		uint64_t maxIter = maxTomsIter;
+		for (int gx = 0; gx < gridDim; gx++)
+		{
+			Bounds cell = { sampleBounds.xmin + cellW * gx, sampleBounds.ymin + cellH * gy,
+				sampleBounds.xmin + cellW * (gx + 1), sampleBounds.ymin + cellH * (gy + 1) };
+
+			SubdivideCell(seeds, func, bounds, cell, maxDepth, filterMeshRes, evalBudget);
+			if (*evalBudget <= 0) return;
+		}
+	}
+}
+
+void ProximalBracketingGenerator::Revalidate(std::vector<Seed>* seeds, const std::vector<Seed>* prevSeeds, Function* funcPtr, Bounds bounds, int filterMeshRes, size_t maxSeeds)
+{
+	// Parameters
+	static constexpr double overshoot = 2.0; // Bracket length relative to the linear estimate of the distance to the curve
+
+	Function& func = *funcPtr;
+	func.SetEvalStage(EvalStage::SEED_PLACEMENT);
+	Bounds exBounds = bounds.Expand(BOUNDS_EXPANSION);
+
+	// Seeds were refined to the previous frame's filter boxes, which are up to twice this size after zooming in
+	double boxSize = std::min(bounds.w(), bounds.h()) / Pow2(filterMeshRes);
+
+	// Thin out the previous seeds if there are more than we are allowed to keep
+	size_t stride = std::max(prevSeeds->size() / std::max(maxSeeds, (size_t)1), (size_t)1);
+
+	for (size_t i = 0; i < prevSeeds->size(); i += stride)
+	{
+		Seed s = (*prevSeeds)[i];
+		if (!exBounds.In(s.x, s.y)) continue;
+
+		s.fs = func(s.x, s.y);
+		if (!std::isfinite(s.fs)) continue;
+		if (s.fs == 0.0)
+		{
+			seeds->push_back(s);
+			continue;
+		}
+
+		// Step against the gradient, past where the linear estimate puts the curve
+		double h = std::max(boxSize * 1e-3, (abs(s.x) + abs(s.y)) * 1e-10);
+		double gx = (func(s.x + h, s.y) - s.fs) / h;
+		double gy = (func(s.x, s.y + h) - s.fs) / h;
+		double gSq = gx * gx + gy * gy;
+		if (!(gSq > 0.0) || !std::isfinite(gSq)) continue;
 
-		double dx = s2.x - s1.x;
-		double dy = s2.y - s1.y;
+		double dist = abs(s.fs) / sqrt(gSq);
+		if (dist > boxSize) continue;
 
-		auto [at, bt] = boost::math::tools::toms748_solve([&](double t) { return func(s1.x + dx * t, s1.y + dy * t); },
-			0.0, 1.0, s1.fs, s2.fs, StopCondition(s1.x, s1.y, dx, dy, absTol, filterMeshRes, &bounds), maxIter);
+		double step = std::clamp(dist * overshoot, h, boxSize) * (s.fs < 0 ? 1.0 : -1.0) / sqrt(gSq);
+		Seed end = { s.x + gx * step, s.y + gy * step };
+		end.fs = func(end.x, end.y);
 
-		double t = (at + bt) / 2;
-		seeds->push_back({ s1.x + dx * t, s1.y + dy * t });
+		// Seeds which don't bracket the curve within a box of the new mesh are dropped
+		if (!std::isfinite(end.fs) || (s.fs < 0) == (end.fs < 0)) continue;
+
+		func.SetEvalStage(EvalStage::REFINEMENT);
+		seeds->push_back(Refine(func, s, end, bounds, filterMeshRes));
+		func.SetEvalStage(EvalStage::SEED_PLACEMENT);
 	}
 }
 
+uint32_t ProximalBracketingGenerator::LaneSeed(uint32_t baseSeed, int lane)
+{
+	// SplitMix64 finalizer
+	uint64_t z = ((uint64_t)baseSeed << 32 | (uint32_t)lane) + 0x9e3779b97f4a7c15;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	z = z ^ (z >> 31);
+	return (uint32_t)z;
+}
+
 double ProximalBracketingGenerator::Distance(const Seed& s1, const Seed& s2)
 {
 	double dx = s2.x - s1.x;
@@ -160,6 +265,89 @@ double ProximalBracketingGenerator::Distance(const Seed& s1, const Seed& s2)
 	return sqrt(dx * dx + dy * dy);
 }
 
+Seed ProximalBracketingGenerator::Refine(Function& func, const Seed& s1, const Seed& s2, Bounds bounds, int filterMeshRes)
+{
+	// Parameters
+	static constexpr double tomsThreshold = 1000.0;
+	static constexpr uint64_t maxTomsIter = 16;
+
+	double absTol = std::min(bounds.w(), bounds.h()) / tomsThreshold;
+	uint64_t maxIter = maxTomsIter;
+
+	double dx = s2.x - s1.x;
+	double dy = s2.y - s1.y;
+
+	auto [at, bt] = boost::math::tools::toms748_solve([&](double t) { return func(s1.x + dx * t, s1.y + dy * t); },
+		0.0, 1.0, s1.fs, s2.fs, StopCondition(s1.x, s1.y, dx, dy, absTol, filterMeshRes, &bounds), maxIter);
+
+	double t = (at + bt) / 2;
+	return { s1.x + dx * t, s1.y + dy * t };
+}
+
+bool ProximalBracketingGenerator::SubdivideCell(std::vector<Seed>* seeds, Function& func, const Bounds& bounds, Bounds cell, int depth, int filterMeshRes, int64_t* evalBudget)
+{
+	// Parameters
+	static constexpr double lipschitzSafety = 2.0;
+
+	// Sample a 3x3 lattice over the cell
+	Seed samples[3][3];
+	for (int sy = 0; sy < 3; sy++)
+	{
+		for (int sx = 0; sx < 3; sx++)
+		{
+			Seed& s = samples[sy][sx];
+			s = { cell.xmin + cell.w() * sx / 2, cell.ymin + cell.h() * sy / 2 };
+			s.fs = func(s.x, s.y);
+			s.active = std::isfinite(s.fs);
+		}
+	}
+	*evalBudget -= 9;
+
+	// Any sign change between neighbouring samples gives a seed
+	double slope = 0.0, minAbs = DBL_MAX;
+	bool found = false;
+	for (int sy = 0; sy < 3; sy++)
+	{
+		for (int sx = 0; sx < 3; sx++)
+		{
+			const Seed& s = samples[sy][sx];
+			if (!s.active) continue;
+			minAbs = std::min(minAbs, abs(s.fs));
+
+			const Seed* neighbours[2] = { (sx < 2) ? &samples[sy][sx + 1] : nullptr, (sy < 2) ? &samples[sy + 1][sx] : nullptr };
+			for (const Seed* n : neighbours)
+			{
+				if (!n || !n->active) continue;
+				slope = std::max(slope, abs(n->fs - s.fs) / Distance(s, *n));
+
+				if ((s.fs < 0) != (n->fs < 0))
+				{
+					seeds->push_back(Refine(func, s, *n, bounds, filterMeshRes));
+					found = true;
+				}
+			}
+		}
+	}
+	if (found) return true;
+
+	// Every point of the cell is within 'reach' of a sample, so with the estimated slope
+	// the cell can't contain a root if all samples are far enough from zero
+	double reach = sqrt(cell.w() * cell.w() + cell.h() * cell.h()) / 4;
+	if (minAbs > lipschitzSafety * slope * reach) return false;
+	if (depth == 0 || *evalBudget <= 0) return false;
+
+	// Recurse into quarters
+	double midX = (cell.xmin + cell.xmax) / 2;
+	double midY = (cell.ymin + cell.ymax) / 2;
+	Bounds quarters[4] = { { cell.xmin, cell.ymin, midX, midY }, { midX, cell.ymin, cell.xmax, midY },
+		{ cell.xmin, midY, midX, cell.ymax }, { midX, midY, cell.xmax, cell.ymax } };
+
+	for (const Bounds& quarter : quarters)
+		found |= SubdivideCell(seeds, func, bounds, quarter, depth - 1, filterMeshRes, evalBudget);
+
+	return found;
+}
+
 StopCondition::StopCondition(double x0, double y0, double dx, double dy, double absTol, int filterMeshRes, Bounds* bounds)
 {
 	double bracketLength = sqrt(dx * dx + dy * dy);
@@ -12,6 +12,7 @@
 #include "pow4.h"
 
 constexpr int SMPL_NUM = 10;
+constexpr double BOUNDS_EXPANSION = 1.1;
 
 class StopCondition
 {
@@ -30,8 +31,24 @@ class ProximalBracketingGenerator
 public:
 	ProximalBracketingGenerator() {};
 
-	static void Generate(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, int maxEval, int filterMeshRes, int seedNum);
+	// Returns false if no sign change could be found
+	static bool Generate(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, int maxEval, int filterMeshRes, int seedNum, uint32_t rngSeed);
+	static bool Generate(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, Bounds sampleBounds, int maxEval, int filterMeshRes, int seedNum, uint32_t rngSeed);
+
+	// Fallbacks for when random seeding finds no sign change, both work on rows [rowStart, rowEnd) of a grid over
+	// sampleBounds. Seeds are refined against the filter mesh of the view's bounds.
+	static void GridScan(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, Bounds sampleBounds, int gridRes, int rowStart, int rowEnd, int filterMeshRes);
+	static void Subdivide(std::vector<Seed>* seeds, Function* funcPtr, Bounds bounds, Bounds sampleBounds, int gridRes, int rowStart, int rowEnd, int maxDepth, int filterMeshRes, int64_t* evalBudget);
+
+	// Re-brackets converged seeds from a previous frame at the filter mesh scale of 'bounds', keeping those
+	// with a sign change within one filter box of them
+	static void Revalidate(std::vector<Seed>* seeds, const std::vector<Seed>* prevSeeds, Function* funcPtr, Bounds bounds, int filterMeshRes, size_t maxSeeds);
+
+	// Derives a well mixed generator seed for one lane of seeds from a base seed
+	static uint32_t LaneSeed(uint32_t baseSeed, int lane);
 
 protected:
 	static double Distance(const Seed& s1, const Seed& s2);
+	static Seed Refine(Function& func, const Seed& s1, const Seed& s2, Bounds bounds, int filterMeshRes);
+	static bool SubdivideCell(std::vector<Seed>* seeds, Function& func, const Bounds& bounds, Bounds cell, int depth, int filterMeshRes, int64_t* evalBudget);
 };
\ No newline at end of file
@@ -15,6 +15,7 @@ Renderer::~Renderer()
 void Renderer::JobPollLoop()
 {
 	std::stop_token token = jobPollThread.get_stop_token();
+	pollThreadIndex = Instrumentation::ThreadIndex();
 
 	bool allComplete = false;
 	while (!token.stop_requested())
@@ -22,6 +23,7 @@ void Renderer::JobPollLoop()
 		if (allComplete)
 		{
 			// Spin idly until signalled to re-check
+			ZONE(poll_idle, &events, NO_JOB);
 			pollingBar.arrive_and_wait();
 		}
 
@@ -51,15 +53,54 @@ void Renderer::JobPollLoop()
 				allComplete = false;
 
 				job->status = JobStatus::PROCESSING;
+				{
+					std::lock_guard lock(job->bufferMutex);
+					job->frameInput = std::exchange(job->pendingInput, {});
+				}
 				ProcessJob(job.get());
 
+				STAGE_ZONE(collect, &events, job->id, &job->timings);
 				std::unique_lock lock(job->bufferMutex);
-				job->bufferedVerts = job->verts;
+				if (memoryBudget)
+				{
+					// Under a budget only one copy of the vertices is kept, the next frame reallocates its own
+					job->bufferedVerts.swap(job->verts);
+					std::vector<float>().swap(job->verts);
+				}
+				else
+					job->bufferedVerts = job->verts;
+				job->bufferedXOrigin = job->xOrigin;
+				job->bufferedYOrigin = job->yOrigin;
+				job->bufferedFrame++;
+
+				// Unpresented input stays with the buffer, its frame was replaced before being drawn
+				if (job->frameInput.ticks && !job->bufferedInput.ticks)
+					job->bufferedInput = job->frameInput;
 				lock.unlock();
+				END_ZONE(collect);
+
+				lock.lock();
+				job->bufferedTimings = job->timings;
+				job->bufferedEvals = job->evals;
+				lock.unlock();
+
+				if (job->frameInput.ticks)
+				{
+					events.Push({ "input_to_buffer", job->id, job->frameInput.ticks, Instrumentation::Ticks(), Instrumentation::ThreadIndex() });
+					job->frameInput = {};
+				}
+				UpdateMemoryUsage(job.get());
+
+				if (job->finishedCallback)
+				{
+					ZONE(finished_callback, &events, job->id);
+					job->finishedCallback();
+				}
 
 				if (job->status == JobStatus::PROCESSING)
 					job->status = JobStatus::COMPLETE;
 
+				EnforceMemoryBudget();
 				break;
 			}
 
@@ -70,16 +111,25 @@ end_loop:
 
 		if (deleteList.size() > 0)
 		{
+			ZONE(poll_delete, &events, NO_JOB);
 			std::unique_lock lock(deleteMutex);
 			for (size_t id : deleteList)
 			{
 				auto pos = std::find_if(jobs.begin(), jobs.end(), [id](std::shared_ptr<Job> job) { return job->id == id; });
 				jobs.erase(pos);
+				ForgetJob(id);
 			}
 
 			deleteList.clear();
 			lock.unlock();
 
+			// Freed memory may let a degraded job have its resolution back
+			if (EnforceMemoryBudget())
+			{
+				outdatedJobs = true;
+				allComplete = false;
+			}
+
 			refreshCallback();
 		}
 
@@ -91,19 +141,20 @@ end_loop:
 	}
 }
 
-bool Renderer::NewJob(std::string_view funcStr, const Bounds& bounds, size_t id, bool isValid)
+bool Renderer::NewJob(std::string_view funcStr, const Bounds& bounds, size_t id, bool isValid, CallbackFun finishedCallback, InputStamp input)
 {
-	auto newJob = std::make_shared<Job>(funcStr, bounds, id);
+	auto newJob = std::make_shared<Job>(funcStr, bounds, id, finishedCallback);
 	bool compValid = newJob->isValid;
 
 	newJob->isValid &= isValid;
+	StampInput(newJob.get(), input);
 	jobs.push_back(newJob);
 
 	SignalJobRescan();
 	return compValid;
 }
 
-bool Renderer::EditJob(size_t id, std::string_view newFunc, bool isValid)
+bool Renderer::EditJob(size_t id, std::string_view newFunc, bool isValid, InputStamp input)
 {
 	std::shared_ptr<Job> job = *std::find_if(jobs.begin(), jobs.end(), [id](std::shared_ptr<Job> job) { return job->id == id; });
 	job->funcs.Change(newFunc);
@@ -111,6 +162,7 @@ bool Renderer::EditJob(size_t id, std::string_view newFunc, bool isValid)
 	bool compValid = job->isValid;
 
 	job->isValid &= isValid;
+	StampInput(job.get(), input);
 	job->status = JobStatus::OUTDATED;
 
 	SignalJobRescan();
@@ -125,36 +177,208 @@ void Renderer::DeleteJob(size_t id)
 	SignalJobRescan();
 }
 
-void Renderer::SetJobColor(size_t id, wxColour col)
+std::optional<StageTimings> Renderer::GetStageTimings(size_t id)
 {
-	std::shared_ptr<Job> job = *std::find_if(jobs.begin(), jobs.end(), [id](std::shared_ptr<Job> job) { return job->id == id; });
-	job->col = col;
+	auto pos = std::find_if(jobs.begin(), jobs.end(), [id](std::shared_ptr<Job> job) { return job->id == id; });
+	if (pos == jobs.end()) return {};
 
-	job->status = JobStatus::OUTDATED;
-	refreshCallback();
+	std::lock_guard lock((*pos)->bufferMutex);
+	return (*pos)->bufferedTimings;
 }
 
-wxColour Renderer::GetJobColour(size_t id)
+std::optional<EvalCounts> Renderer::GetEvalCounts(size_t id)
 {
-	std::shared_ptr<Job> job = *std::find_if(jobs.begin(), jobs.end(), [id](std::shared_ptr<Job> job) { return job->id == id; });
-	return job->col;
+	auto pos = std::find_if(jobs.begin(), jobs.end(), [id](std::shared_ptr<Job> job) { return job->id == id; });
+	if (pos == jobs.end()) return {};
+
+	std::lock_guard lock((*pos)->bufferMutex);
+	return (*pos)->bufferedEvals;
+}
+
+std::optional<std::vector<double>> Renderer::GetVerts(size_t id)
+{
+	auto pos = std::find_if(jobs.begin(), jobs.end(), [id](std::shared_ptr<Job> job) { return job->id == id; });
+	if (pos == jobs.end()) return {};
+
+	std::lock_guard lock((*pos)->bufferMutex);
+	const Job& job = **pos;
+
+	std::vector<double> verts(job.bufferedVerts.size());
+	for (size_t i = 0; i < verts.size(); i += 2)
+	{
+		verts[i] = job.bufferedXOrigin + job.bufferedVerts[i];
+		verts[i + 1] = job.bufferedYOrigin + job.bufferedVerts[i + 1];
+	}
+	return verts;
+}
+
+std::optional<MemoryUsage> Renderer::GetMemoryUsage(size_t id)
+{
+	auto pos = std::find_if(jobs.begin(), jobs.end(), [id](std::shared_ptr<Job> job) { return job->id == id; });
+	if (pos == jobs.end()) return {};
+
+	std::lock_guard lock((*pos)->bufferMutex);
+	return (*pos)->bufferedMemory;
+}
+
+size_t Renderer::GetHeldMemory()
+{
+	size_t held = 0;
+	for (std::shared_ptr<Job> job : jobs)
+	{
+		std::lock_guard lock(job->bufferMutex);
+		held += job->bufferedMemory.Held();
+	}
+	return held;
+}
+
+void Renderer::SetMemoryBudget(size_t bytes)
+{
+	memoryBudget = bytes;
+
+	// Jobs start from full resolution and degrade again if they need to
+	for (std::shared_ptr<Job> job : jobs)
+		job->resolutionDrop = 0;
+	UpdateJobs();
+}
+
+size_t Renderer::GetMemoryBudget()
+{
+	return memoryBudget;
+}
+
+void Renderer::UpdateMemoryUsage(Job* job)
+{
+	MemoryUsage& usage = job->memory;
+	usage.verts = job->verts.capacity() * sizeof(float);
+	usage.bufferedVerts = job->bufferedVerts.capacity() * sizeof(float);
+	usage.functions = job->funcs.MemoryBytes();
+
+	usage.seeds = usage.mesh = usage.warmStart = 0;
+	CountCachedMemory(job->id, &usage);
+
+	std::lock_guard lock(job->bufferMutex);
+	job->bufferedMemory = usage;
+}
+
+// Runs on the poll thread after each frame, returns true if any job was marked for re-rendering
+bool Renderer::EnforceMemoryBudget()
+{
+	size_t budget = memoryBudget;
+	if (budget == 0) return false;
+
+	// Cached data only speeds frames up or decorates them, so it goes first
+	if (GetHeldMemory() > budget)
+	{
+		EvictCaches();
+		for (std::shared_ptr<Job> job : jobs)
+			UpdateMemoryUsage(job.get());
+	}
+
+	size_t held = GetHeldMemory();
+	if (held > budget)
+	{
+		// Each level dropped roughly halves a curve's vertices, take one from the biggest job that has any left
+		int maxDrop = MaxResolutionDrop();
+		Job* largest = nullptr;
+		for (std::shared_ptr<Job> job : jobs)
+		{
+			if (job->resolutionDrop < maxDrop && (!largest || job->memory.bufferedVerts > largest->memory.bufferedVerts))
+				largest = job.get();
+		}
+		if (!largest) return false;
+
+		largest->resolutionDrop++;
+		largest->status = JobStatus::OUTDATED;
+		return true;
+	}
+
+	// Give the most degraded job a level back once its doubled vertices fit alongside the old ones while it renders
+	Job* degraded = nullptr;
+	for (std::shared_ptr<Job> job : jobs)
+	{
+		if (job->resolutionDrop > 0 && (!degraded || job->resolutionDrop > degraded->resolutionDrop))
+			degraded = job.get();
+	}
+	if (!degraded || held + 2 * degraded->memory.bufferedVerts > budget) return false;
+
+	degraded->resolutionDrop--;
+	degraded->status = JobStatus::OUTDATED;
+	return true;
+}
+
+std::vector<ZoneEvent> Renderer::GetZoneEvents()
+{
+	return events.Snapshot();
+}
+
+void Renderer::WriteChromeTrace(std::ostream& out)
+{
+	// Everything but the poll thread ran on the renderer's pool or the caller's thread
+	std::map<uint32_t, std::string> threadNames;
+	if (pollThreadIndex != UINT32_MAX)
+		threadNames[pollThreadIndex] = "poll";
+
+	Instrumentation::WriteChromeTrace(out, events.Snapshot(), threadNames);
 }
 
-void Renderer::UpdateJobs()
+void Renderer::UpdateJobs(InputStamp input)
 {
 	for (std::shared_ptr<Job> job : jobs)
+	{
+		StampInput(job.get(), input);
 		job->status = JobStatus::OUTDATED;
+	}
 
 	SignalJobRescan();
 }
 
+void Renderer::StampInput(Job* job, InputStamp input)
+{
+	// Invalid jobs never render, so their input would never be answered
+	if (!input.ticks || !job->isValid) return;
+
+	// Only the oldest input is kept, it's the one waiting longest
+	std::lock_guard lock(job->bufferMutex);
+	if (!job->pendingInput.ticks)
+		job->pendingInput = input;
+}
+
+void Renderer::SetDeterministic(bool value)
+{
+	deterministic = value;
+	UpdateJobs();
+}
+
+bool Renderer::IsDeterministic()
+{
+	return deterministic;
+}
+
+int Renderer::DefaultThreadNum()
+{
+	return std::max((int)std::thread::hardware_concurrency() - 1, 1);
+}
+
 void Renderer::SignalJobRescan()
 {
-	pollingBar.arrive();
+	(void)pollingBar.arrive();
 }
 
-Job::Job(std::string_view funcStr, const Bounds& bounds_, size_t id_)
-	: bounds(bounds_), funcs(funcStr, 1), id(id_), col(0, 0, 0)
+size_t MemoryUsage::Held() const
+{
+	return verts + bufferedVerts + functions + seeds + mesh + warmStart;
+}
+
+Job::Job(std::string_view funcStr, const Bounds& bounds_, size_t id_, CallbackFun finishedCallback_)
+	: bounds(bounds_), funcs(funcStr, 1), id(id_), finishedCallback(finishedCallback_)
 {
 	isValid = funcs.isValid;
+}
+
+void Job::ResetVerts(const Bounds& frameBounds)
+{
+	verts.clear();
+	xOrigin = (frameBounds.xmin + frameBounds.xmax) / 2;
+	yOrigin = (frameBounds.ymin + frameBounds.ymax) / 2;
 }
\ No newline at end of file
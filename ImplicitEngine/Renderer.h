@@ -6,12 +6,15 @@
 #include <thread>
 #include <mutex>
 #include <barrier>
-
-#include <wx/colour.h>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <utility>
 
 #include "Bounds.h"
-#include "Timer.h"
 #include "FunctionPack.h"
+#include "Instrumentation.h"
 
 enum class JobStatus { OUTDATED, PROCESSING, COMPLETE };
 typedef std::function<void()> CallbackFun;
@@ -19,18 +22,73 @@ typedef std::function<void()> CallbackFun;
 class Canvas;
 class Main;
 
+// Wall time spent in each stage of a job's last frame, filled by STAGE_ZONEs so stages a renderer
+// doesn't have stay zero. Stage zones keep timing in builds without instrumentation.
+struct StageTimings
+{
+	std::chrono::nanoseconds seeding{ 0 }; // Seed generation and refinement
+	std::chrono::nanoseconds mesh{ 0 }; // Building the filter or coverage mesh
+	std::chrono::nanoseconds fill{ 0 }; // Evaluating the band boundary rows
+	std::chrono::nanoseconds contour{ 0 }; // Contouring or tracing
+	std::chrono::nanoseconds collect{ 0 }; // Gathering thread outputs and buffering them
+};
+
+// Bytes held for a job, counted by capacity since that's what is allocated
+struct MemoryUsage
+{
+	size_t verts = 0; // Working vertices, reused by the next frame
+	size_t bufferedVerts = 0; // Vertices being displayed
+	size_t functions = 0; // Per-thread function copies
+	size_t seeds = 0; // Seeds kept for display
+	size_t mesh = 0; // Filter mesh kept for display
+	size_t warmStart = 0; // Seeds kept to warm start the next frame
+	size_t transient = 0; // Peak scratch buffers of the last frame, already freed
+
+	// Memory held between frames, transient buffers are excluded
+	size_t Held() const;
+};
+
+// User input a frame answers, for measuring input to present latency
+enum class InputSource { SCROLL, DRAG, EQUATION_EDIT, COUNT };
+
+struct InputStamp
+{
+	uint64_t ticks = 0; // Instrumentation::Ticks when the input arrived, 0 for no input
+	InputSource source = InputSource::SCROLL;
+};
+
 struct Job
 {
-	Job(std::string_view funcStr, const Bounds& bounds_, size_t id_);
+	Job(std::string_view funcStr, const Bounds& bounds_, size_t id_, CallbackFun finishedCallback_);
+
+	// Clears the working vertices and moves their origin to the centre of the frame's bounds
+	void ResetVerts(const Bounds& frameBounds);
 
 	JobStatus status = JobStatus::OUTDATED;
 	Bounds bounds;
 	FunctionPack funcs;
-	std::vector<double> verts, bufferedVerts;
+	// Line vertices as x, y pairs of floats relative to a double origin in the view, which keeps them precise
+	// at any zoom around any point. The buffered origin is copied along with the buffered vertices.
+	std::vector<float> verts, bufferedVerts;
+	double xOrigin = 0.0, yOrigin = 0.0;
+	double bufferedXOrigin = 0.0, bufferedYOrigin = 0.0;
 	std::mutex bufferMutex;
+	uint64_t bufferedFrame = 0; // Bumped whenever bufferedVerts change, guarded by bufferMutex
 	size_t id;
-	wxColour col;
+	StageTimings timings;
+	EvalCounts evals; // Function evaluations made by the last frame
+	MemoryUsage memory; // As of the end of the last frame
+	// Copies of the above published for other threads, guarded by bufferMutex
+	StageTimings bufferedTimings;
+	EvalCounts bufferedEvals;
+	MemoryUsage bufferedMemory;
+	int resolutionDrop = 0; // Final mesh levels given up to stay within the memory budget
+	CallbackFun finishedCallback; // Called from the poll thread once new vertices are buffered
 	bool isValid;
+
+	// Oldest input no frame has started on yet, taken into frameInput as a frame starts, then into
+	// bufferedInput once buffered for the presenter to clear. Pending and buffered are guarded by bufferMutex.
+	InputStamp pendingInput, frameInput, bufferedInput;
 };
 
 class Renderer
@@ -41,24 +99,68 @@ public:
 
 	void JobPollLoop();
 
-	bool NewJob(std::string_view funcStr, const Bounds& bounds, size_t id, bool isValid);
-	bool EditJob(size_t id, std::string_view newFunc, bool isValid);
+	bool NewJob(std::string_view funcStr, const Bounds& bounds, size_t id, bool isValid, CallbackFun finishedCallback = nullptr, InputStamp input = {});
+	bool EditJob(size_t id, std::string_view newFunc, bool isValid, InputStamp input = {});
 	void DeleteJob(size_t id);
-	void SetJobColor(size_t id, wxColour col);
-	wxColour GetJobColour(size_t id);
+	std::optional<StageTimings> GetStageTimings(size_t id);
+	std::optional<EvalCounts> GetEvalCounts(size_t id);
+
+	// Copy of the job's last buffered line vertices, as x, y pairs in world coordinates
+	std::optional<std::vector<double>> GetVerts(size_t id);
+
+	std::optional<MemoryUsage> GetMemoryUsage(size_t id);
+	size_t GetHeldMemory();
 
-	void UpdateJobs();
+	// Caps the memory held by all jobs, 0 for no budget. Over budget, cached data is evicted first,
+	// then the job with the most vertices loses a level of resolution each frame until it fits.
+	void SetMemoryBudget(size_t bytes);
+	size_t GetMemoryBudget();
+
+	// Most recent zones recorded by this renderer, oldest first
+	std::vector<ZoneEvent> GetZoneEvents();
+	void WriteChromeTrace(std::ostream& out);
+
+	// Re-renders every job, input stamps them with what caused it if it's user input
+	void UpdateJobs(InputStamp input = {});
 	void SignalJobRescan();
 
+	// Deterministic mode gives bit-identical output for identical inputs, regardless of thread count
+	void SetDeterministic(bool value);
+	bool IsDeterministic();
+
+	// Worker threads used when a renderer isn't given a count, leaves one core for the UI
+	static int DefaultThreadNum();
+
 protected:
 	virtual void ProcessJob(Job* job) = 0;
 
+	// Per-job data renderers keep between frames, reported, evicted and forgotten through these
+	virtual void CountCachedMemory(size_t, MemoryUsage*) {}
+	virtual void EvictCaches() {}
+	virtual void ForgetJob(size_t) {}
+	// Levels a job can drop before the renderer's resolution floor, past which degrading frees nothing
+	virtual int MaxResolutionDrop() { return maxResolutionDrop; }
+
+	void StampInput(Job* job, InputStamp input);
+	void UpdateMemoryUsage(Job* job);
+	bool EnforceMemoryBudget();
+
+	// Lowest resolution a job can be degraded to, relative to the renderer's final mesh resolution
+	static constexpr int maxResolutionDrop = 4;
+
 	std::list<std::shared_ptr<Job>> jobs;
+	EventRing events;
+	std::atomic<uint32_t> pollThreadIndex = UINT32_MAX;
 	std::barrier<> pollingBar;
 	std::mutex deleteMutex;
 	std::list<size_t> deleteList;
 	CallbackFun refreshCallback;
 
+	bool deterministic = false;
+	uint32_t deterministicSeed = 0x5EED5EED;
+
+	std::atomic<size_t> memoryBudget = 0;
+
 	std::jthread jobPollThread;
 
 	friend Canvas;
@@ -0,0 +1,7 @@
+#include "ScreenTransform.h"
+
+double ScreenTransform::FoldOrigin(double origin, double scale, double offset)
+{
+	// (world - origin) * scale + (origin * scale - offset) = world * scale - offset
+	return origin * scale - offset;
+}
\ No newline at end of file
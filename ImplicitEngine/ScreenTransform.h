@@ -0,0 +1,10 @@
+#pragma once
+
+// World to normalized device coordinates, screen = world * scale - offset for each axis. The mapping
+// itself runs in the vertex shaders, this folds the double precision parts before they're uploaded.
+namespace ScreenTransform
+{
+	// For one axis of vertices stored relative to an origin, screen = local * scale + FoldOrigin(origin, scale, offset).
+	// The origin is folded in double precision, so floats only carry the geometry's extent.
+	double FoldOrigin(double origin, double scale, double offset);
+}
\ No newline at end of file
@@ -0,0 +1,404 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <immintrin.h>
+
+#include "Arch.h"
+
+SoftwareRasterizer::SoftwareRasterizer(int w_, int h_, const Bounds& view_)
+	: w(w_), h(h_), stride((w_ + lanes - 1) / lanes * lanes), view(view_),
+	pixels((size_t)w_ * h_ * 4), coverage((size_t)stride * h_)
+{}
+
+void SoftwareRasterizer::Clear(RGBA col)
+{
+	for (size_t pi = 0; pi < pixels.size(); pi += 4)
+	{
+		pixels[pi] = col.r;
+		pixels[pi + 1] = col.g;
+		pixels[pi + 2] = col.b;
+		pixels[pi + 3] = col.a;
+	}
+}
+
+void SoftwareRasterizer::DrawGrid(RGBA col)
+{
+	// Major lines about a tenth of the image apart, rounded to 1, 2 or 5 times a power of ten
+	double target = std::max(w, h) / 10.0 / w * view.w();
+	double exponent = std::floor(std::log10(target));
+	double spacing = std::pow(10.0, exponent);
+	for (double mantissa : { 2.0, 5.0, 10.0 })
+		if (std::abs(target - mantissa * std::pow(10.0, exponent)) < std::abs(target - spacing))
+			spacing = mantissa * std::pow(10.0, exponent);
+
+	// Lines are counted rather than stepped to, at deep zooms adding step may not change x at all
+	auto lineNum = [&](double start, double min, double max, double step, int pixels) -> int64_t
+		{
+			double ulp = std::nextafter(std::max(std::abs(min), std::abs(max)), INFINITY) - std::max(std::abs(min), std::abs(max));
+			if (step < (max - min) / pixels || step <= ulp) return 0; // Finer than a pixel or than doubles can place
+			return std::min((int64_t)std::floor((max - start) / step) + 1, (int64_t)pixels);
+		};
+
+	auto drawLines = [&](double step, RGBA lineCol)
+		{
+			std::vector<float> segs;
+			double startX = std::ceil(view.xmin / step) * step;
+			int64_t num = lineNum(startX, view.xmin, view.xmax, step, w);
+			for (int64_t xi = 0; xi < num; xi++)
+			{
+				float px = (float)((startX + xi * step - view.xmin) / view.w() * w);
+				segs.insert(segs.end(), { px, 0.0f, px, (float)h });
+			}
+
+			double startY = std::ceil(view.ymin / step) * step;
+			num = lineNum(startY, view.ymin, view.ymax, step, h);
+			for (int64_t yi = 0; yi < num; yi++)
+			{
+				float py = (float)((view.ymax - (startY + yi * step)) / view.h() * h);
+				segs.insert(segs.end(), { 0.0f, py, (float)w, py });
+			}
+			DrawSegments(segs, 1.0f, lineCol);
+		};
+
+	drawLines(spacing / 5, { col.r, col.g, col.b, (uint8_t)(col.a / 3) }); // Minor
+	drawLines(spacing, col); // Major
+}
+
+void SoftwareRasterizer::DrawAxes(float width, RGBA col)
+{
+	float px = (float)(-view.xmin / view.w() * w);
+	float py = (float)(view.ymax / view.h() * h);
+	DrawSegments({ 0.0f, py, (float)w, py, px, 0.0f, px, (float)h }, width, col);
+}
+
+void SoftwareRasterizer::DrawLines(const std::vector<double>& verts, float width, RGBA col)
+{
+	double xScale = w / view.w();
+	double yScale = h / view.h();
+
+	// Pixel coordinates are relative to the view, so floats keep full precision at any zoom
+	std::vector<float> segs(verts.size() / 4 * 4);
+	for (size_t vi = 0; vi < segs.size(); vi += 2)
+	{
+		segs[vi] = (float)((verts[vi] - view.xmin) * xScale);
+		segs[vi + 1] = (float)((view.ymax - verts[vi + 1]) * yScale);
+	}
+	DrawSegments(segs, width, col);
+}
+
+int SoftwareRasterizer::GetWidth() const
+{
+	return w;
+}
+
+int SoftwareRasterizer::GetHeight() const
+{
+	return h;
+}
+
+const std::vector<uint8_t>& SoftwareRasterizer::GetPixels() const
+{
+	return pixels;
+}
+
+void SoftwareRasterizer::DrawSegments(const std::vector<float>& segs, float width, RGBA col)
+{
+	if (w <= 0 || h <= 0) return;
+
+	bool useAVX = Arch::HasInstructions<AVX2>() && Arch::HasInstructions<FMA>();
+	float radius = width / 2 + 0.5f;
+
+	// Bounding box of everything covered, only that is composited and cleared
+	int minX = stride, minY = h, maxX = 0, maxY = 0;
+	for (size_t si = 0; si + 3 < segs.size(); si += 4)
+	{
+		float ax = segs[si], ay = segs[si + 1], bx = segs[si + 2], by = segs[si + 3];
+		if (!std::isfinite(ax) || !std::isfinite(ay) || !std::isfinite(bx) || !std::isfinite(by)) continue;
+
+		int x0 = std::max((int)std::floor(std::min(ax, bx) - radius), 0);
+		int x1 = std::min((int)std::ceil(std::max(ax, bx) + radius), w);
+		int y0 = std::max((int)std::floor(std::min(ay, by) - radius), 0);
+		int y1 = std::min((int)std::ceil(std::max(ay, by) + radius), h);
+		if (x0 >= x1 || y0 >= y1) continue;
+
+		SegmentParams seg = { ax, ay, bx - ax, by - ay, 0.0f, radius };
+		float len2 = seg.dx * seg.dx + seg.dy * seg.dy;
+		if (len2 > 0.0f) seg.invLen2 = 1.0f / len2;
+
+		// Rows are covered in whole lanes, the padding past w is never composited
+		x0 = x0 / lanes * lanes;
+		x1 = (x1 + lanes - 1) / lanes * lanes;
+		for (int y = y0; y < y1; y++)
+		{
+			float* row = coverage.data() + (size_t)y * stride;
+			if (useAVX)
+				CoverRowAVX(row, x0, x1, y + 0.5f, seg);
+			else
+				CoverRowScalar(row, x0, x1, y + 0.5f, seg);
+		}
+
+		minX = std::min(minX, x0); maxX = std::max(maxX, x1);
+		minY = std::min(minY, y0); maxY = std::max(maxY, y1);
+	}
+
+	if (minX < maxX && minY < maxY)
+		Composite(minX, minY, std::min(maxX, w), maxY, col);
+}
+
+void SoftwareRasterizer::Composite(int x0, int y0, int x1, int y1, RGBA col)
+{
+	float alpha = col.a / 255.0f;
+	for (int y = y0; y < y1; y++)
+	{
+		float* row = coverage.data() + (size_t)y * stride;
+		for (int x = x0; x < x1; x++)
+		{
+			float a = row[x] * alpha;
+			if (a <= 0.0f) continue;
+
+			// Source over, the destination is treated as opaque
+			uint8_t* px = pixels.data() + ((size_t)y * w + x) * 4;
+			px[0] = (uint8_t)std::lround(px[0] + (col.r - px[0]) * a);
+			px[1] = (uint8_t)std::lround(px[1] + (col.g - px[1]) * a);
+			px[2] = (uint8_t)std::lround(px[2] + (col.b - px[2]) * a);
+			px[3] = (uint8_t)std::lround(px[3] + (255 - px[3]) * a);
+		}
+
+		// Includes the lane padding past x1
+		std::fill(row + x0, row + std::min((x1 + lanes - 1) / lanes * lanes, stride), 0.0f);
+	}
+}
+
+TARGET_AVX2_FMA void SoftwareRasterizer::CoverRowAVX(float* row, int x0, int x1, float py, const SegmentParams& seg)
+{
+	__m256 ax = _mm256_set1_ps(seg.ax), dx = _mm256_set1_ps(seg.dx);
+	__m256 dy = _mm256_set1_ps(seg.dy), invLen2 = _mm256_set1_ps(seg.invLen2);
+	__m256 radius = _mm256_set1_ps(seg.radius);
+	__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+
+	// The row's y offset from the segment start is shared by every lane
+	float rely = py - seg.ay;
+	__m256 relY = _mm256_set1_ps(rely);
+	__m256 relYdy = _mm256_set1_ps(rely * seg.dy);
+
+	__m256 px = _mm256_add_ps(_mm256_set1_ps((float)x0 + 0.5f), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+	__m256 step = _mm256_set1_ps((float)lanes);
+	for (int x = x0; x < x1; x += lanes)
+	{
+		// t = clamp(dot(p - a, d) / |d|^2, 0, 1), the closest point's position along the segment
+		__m256 relX = _mm256_sub_ps(px, ax);
+		__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(relX, dx), relYdy), invLen2);
+		t = _mm256_min_ps(_mm256_max_ps(t, zero), one);
+
+		__m256 ex = _mm256_sub_ps(relX, _mm256_mul_ps(t, dx));
+		__m256 ey = _mm256_sub_ps(relY, _mm256_mul_ps(t, dy));
+		__m256 dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)));
+
+		__m256 cover = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(radius, dist), zero), one);
+		_mm256_storeu_ps(row + x, _mm256_max_ps(_mm256_loadu_ps(row + x), cover));
+
+		px = _mm256_add_ps(px, step);
+	}
+}
+
+void SoftwareRasterizer::CoverRowScalar(float* row, int x0, int x1, float py, const SegmentParams& seg)
+{
+	float rely = py - seg.ay;
+	for (int x = x0; x < x1; x++)
+	{
+		float relx = x + 0.5f - seg.ax;
+		float t = std::clamp((relx * seg.dx + rely * seg.dy) * seg.invLen2, 0.0f, 1.0f);
+
+		float ex = relx - t * seg.dx;
+		float ey = rely - t * seg.dy;
+		float cover = std::clamp(seg.radius - std::sqrt(ex * ex + ey * ey), 0.0f, 1.0f);
+		row[x] = std::max(row[x], cover);
+	}
+}
+
+bool SoftwareRasterizer::WritePPM(std::ostream& out) const
+{
+	out << "P6\n" << w << ' ' << h << "\n255\n";
+
+	std::vector<char> rgb((size_t)w * h * 3);
+	for (size_t pi = 0; pi < (size_t)w * h; pi++)
+		std::copy_n(pixels.begin() + pi * 4, 3, rgb.begin() + pi * 3);
+	out.write(rgb.data(), rgb.size());
+
+	return (bool)out;
+}
+
+// PNG is written without external dependencies: rows use the Sub filter and the zlib stream is
+// deflated with the fixed Huffman code, matching only runs of repeated bytes. Flat backgrounds filter
+// to long runs of zeros, which is most of a plot.
+namespace
+{
+	class BitWriter
+	{
+	public:
+		std::vector<uint8_t> bytes;
+
+		// Values go in least significant bit first
+		void Write(uint32_t value, int bitNum)
+		{
+			for (int bi = 0; bi < bitNum; bi++)
+			{
+				if (used == 0) bytes.push_back(0);
+				bytes.back() |= ((value >> bi) & 1) << used;
+				used = (used + 1) % 8;
+			}
+		}
+
+		// Huffman codes go in most significant bit first
+		void WriteCode(uint32_t code, int bitNum)
+		{
+			for (int bi = bitNum - 1; bi >= 0; bi--)
+				Write((code >> bi) & 1, 1);
+		}
+
+	private:
+		int used = 0;
+	};
+
+	void WriteLiteral(BitWriter* bits, int symbol)
+	{
+		if (symbol < 144) bits->WriteCode(0x30 + symbol, 8);
+		else if (symbol < 256) bits->WriteCode(0x190 + symbol - 144, 9);
+		else if (symbol < 280) bits->WriteCode(symbol - 256, 7);
+		else bits->WriteCode(0xC0 + symbol - 280, 8);
+	}
+
+	void WriteRun(BitWriter* bits, int length)
+	{
+		static constexpr std::array<int, 29> bases = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+			35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static constexpr std::array<int, 29> extras = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+			3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+		int code = (int)(std::upper_bound(bases.begin(), bases.end(), length) - bases.begin()) - 1;
+		WriteLiteral(bits, 257 + code);
+		bits->Write(length - bases[code], extras[code]);
+		bits->WriteCode(0, 5); // Distance 1
+	}
+
+	std::vector<uint8_t> Deflate(const std::vector<uint8_t>& data)
+	{
+		static constexpr int minRun = 3;
+		static constexpr int maxRun = 258;
+
+		BitWriter bits;
+		bits.Write(1, 1); // Final block
+		bits.Write(1, 2); // Fixed Huffman
+
+		size_t i = 0;
+		while (i < data.size())
+		{
+			size_t run = 0;
+			if (i > 0)
+				while (run < maxRun && i + run < data.size() && data[i + run] == data[i - 1]) run++;
+
+			if (run >= minRun)
+			{
+				WriteRun(&bits, (int)run);
+				i += run;
+			}
+			else
+				WriteLiteral(&bits, data[i++]);
+		}
+		WriteLiteral(&bits, 256); // End of block
+
+		// zlib wrapper
+		uint32_t a = 1, b = 0;
+		for (uint8_t byte : data)
+		{
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		uint32_t adler = (b << 16) | a;
+
+		std::vector<uint8_t> out = { 0x78, 0x01 };
+		out.insert(out.end(), bits.bytes.begin(), bits.bytes.end());
+		for (int shift = 24; shift >= 0; shift -= 8)
+			out.push_back((uint8_t)(adler >> shift));
+		return out;
+	}
+
+	uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc)
+	{
+		static const std::array<uint32_t, 256> table = []()
+			{
+				std::array<uint32_t, 256> ret{};
+				for (uint32_t n = 0; n < 256; n++)
+				{
+					uint32_t c = n;
+					for (int k = 0; k < 8; k++)
+						c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					ret[n] = c;
+				}
+				return ret;
+			}();
+
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return crc;
+	}
+
+	void WriteChunk(std::ostream& out, const char* type, const std::vector<uint8_t>& data)
+	{
+		auto writeU32 = [&](uint32_t value)
+			{
+				for (int shift = 24; shift >= 0; shift -= 8)
+					out.put((char)(value >> shift));
+			};
+
+		writeU32((uint32_t)data.size());
+		out.write(type, 4);
+		out.write((const char*)data.data(), data.size());
+
+		uint32_t crc = Crc32((const uint8_t*)type, 4, 0xFFFFFFFFu);
+		crc = Crc32(data.data(), data.size(), crc);
+		writeU32(crc ^ 0xFFFFFFFFu);
+	}
+}
+
+bool SoftwareRasterizer::WritePNG(std::ostream& out) const
+{
+	static constexpr uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.write((const char*)signature, sizeof(signature));
+
+	// 8 bit RGBA, no interlacing
+	std::vector<uint8_t> header;
+	for (uint32_t dim : { (uint32_t)w, (uint32_t)h })
+		for (int shift = 24; shift >= 0; shift -= 8)
+			header.push_back((uint8_t)(dim >> shift));
+	header.insert(header.end(), { 8, 6, 0, 0, 0 });
+	WriteChunk(out, "IHDR", header);
+
+	// Sub filter, each byte minus the same channel of the pixel to its left
+	size_t rowBytes = (size_t)w * 4;
+	std::vector<uint8_t> filtered;
+	filtered.reserve((rowBytes + 1) * h);
+	for (int y = 0; y < h; y++)
+	{
+		const uint8_t* row = pixels.data() + y * rowBytes;
+		filtered.push_back(1);
+		for (size_t bi = 0; bi < rowBytes; bi++)
+			filtered.push_back((uint8_t)(row[bi] - (bi >= 4 ? row[bi - 4] : 0)));
+	}
+
+	WriteChunk(out, "IDAT", Deflate(filtered));
+	WriteChunk(out, "IEND", {});
+	return (bool)out;
+}
+
+bool SoftwareRasterizer::Write(const std::string& path) const
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out) return false;
+
+	bool ppm = path.size() >= 4 && path.compare(path.size() - 4, 4, ".ppm") == 0;
+	return ppm ? WritePPM(out) : WritePNG(out);
+}
\ No newline at end of file
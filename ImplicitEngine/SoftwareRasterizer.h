@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <ostream>
+
+#include "Bounds.h"
+
+struct RGBA
+{
+	uint8_t r, g, b, a;
+};
+
+// CPU rasterizer for turning job results into images without a GL context or display. Lines are
+// anti-aliased by each pixel's distance to the segment, with coverage computed eight pixels at a
+// time on CPUs with AVX2 and FMA. Coverage of one draw is merged by maximum before blending, so
+// segment joints of the same curve don't darken.
+class SoftwareRasterizer
+{
+public:
+	SoftwareRasterizer(int w_, int h_, const Bounds& view_);
+
+	void Clear(RGBA col);
+	// Gridlines spaced like the canvas, minor lines at a third of the major lines' opacity
+	void DrawGrid(RGBA col);
+	void DrawAxes(float width, RGBA col);
+	// Line vertices as x, y pairs in world space, the layout of Job::verts
+	void DrawLines(const std::vector<double>& verts, float width, RGBA col);
+
+	int GetWidth() const;
+	int GetHeight() const;
+	const std::vector<uint8_t>& GetPixels() const; // RGBA rows, top row first
+
+	bool WritePPM(std::ostream& out) const;
+	bool WritePNG(std::ostream& out) const;
+	// Format is picked by extension, .ppm or .png
+	bool Write(const std::string& path) const;
+
+protected:
+	// Segment in pixel space, prepared for distance evaluation
+	struct SegmentParams
+	{
+		float ax, ay, dx, dy;
+		float invLen2; // 0 for degenerate segments, which are treated as points
+		float radius; // Half the line width plus half a pixel, coverage falls off linearly to it
+	};
+
+	static constexpr int lanes = 8;
+
+	int w, h;
+	int stride; // Coverage row length, padded to whole lanes
+	Bounds view;
+	std::vector<uint8_t> pixels;
+	std::vector<float> coverage; // Zero outside a draw
+
+	// Draws segments given as x1, y1, x2, y2 in pixel coordinates
+	void DrawSegments(const std::vector<float>& segs, float width, RGBA col);
+	void Composite(int x0, int y0, int x1, int y1, RGBA col);
+
+	static void CoverRowAVX(float* row, int x0, int x1, float py, const SegmentParams& seg);
+	static void CoverRowScalar(float* row, int x0, int x1, float py, const SegmentParams& seg);
+};
\ No newline at end of file
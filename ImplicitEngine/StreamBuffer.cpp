@@ -0,0 +1,100 @@
+#include "StreamBuffer.h"
+
+#include <cstring>
+#include <iostream>
+
+StreamBuffer::StreamBuffer(size_t regionSize_)
+	: regionSize((regionSize_ + regionAlignment - 1) / regionAlignment * regionAlignment)
+{
+	Create();
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	Destroy();
+}
+
+void StreamBuffer::Bind(GLenum target) const
+{
+	GlCall(glBindBuffer(target, dataID));
+}
+
+void StreamBuffer::BeginFrame()
+{
+	region = (region + 1) % regionNum;
+	regionUsed = 0;
+	Wait(fences[region]);
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (fences[region]) glDeleteSync(fences[region]);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+size_t StreamBuffer::Write(const void* data, size_t size, size_t alignment, bool* reallocated)
+{
+	size_t start = (regionUsed + alignment - 1) / alignment * alignment;
+	if (start + size > regionSize)
+	{
+		// Draws already issued this frame read the old buffer, so wait for them before replacing it
+		GlCall(glFinish());
+		Destroy();
+		while (start + size > regionSize) regionSize *= 2;
+		Create();
+		if (reallocated) *reallocated = true;
+	}
+
+	size_t offset = region * regionSize + start;
+	if (mapped)
+		std::memcpy(mapped + offset, data, size);
+	else
+	{
+		GlCall(glBindBuffer(GL_ARRAY_BUFFER, dataID));
+		GlCall(glBufferSubData(GL_ARRAY_BUFFER, offset, size, data));
+	}
+	regionUsed = start + size;
+	return offset;
+}
+
+void StreamBuffer::Create()
+{
+	static constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	GlCall(glGenBuffers(1, &dataID));
+	GlCall(glBindBuffer(GL_ARRAY_BUFFER, dataID));
+	GlCall(glBufferStorage(GL_ARRAY_BUFFER, regionSize * regionNum, nullptr, flags));
+	mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * regionNum, flags);
+	if (mapped) return;
+
+	// Immutable storage can't be respecified, so replace it with an ordinary buffer written through glBufferSubData
+	std::cerr << "Failed to map stream buffer, falling back to glBufferSubData\n";
+	glDeleteBuffers(1, &dataID);
+	GlCall(glGenBuffers(1, &dataID));
+	GlCall(glBindBuffer(GL_ARRAY_BUFFER, dataID));
+	GlCall(glBufferData(GL_ARRAY_BUFFER, regionSize * regionNum, nullptr, GL_DYNAMIC_DRAW));
+}
+
+void StreamBuffer::Destroy()
+{
+	for (GLsync& fence : fences)
+		Wait(fence);
+
+	GlCall(glBindBuffer(GL_ARRAY_BUFFER, dataID));
+	if (mapped) glUnmapBuffer(GL_ARRAY_BUFFER);
+	glDeleteBuffers(1, &dataID);
+	mapped = nullptr;
+}
+
+void StreamBuffer::Wait(GLsync& fence)
+{
+	if (!fence) return;
+
+	// Flush on the first wait so the fence is guaranteed to signal
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (result == GL_TIMEOUT_EXPIRED)
+		result = glClientWaitSync(fence, 0, 1'000'000);
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
\ No newline at end of file
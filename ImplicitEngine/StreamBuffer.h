@@ -0,0 +1,42 @@
+#pragma once
+#include "glall.h"
+
+#include <array>
+
+// Persistently mapped buffer for data rewritten every frame, drawn from directly or used as staging for
+// copies into other buffers. It is split into regions used
+// round robin, one per frame, each fenced once drawn so the CPU never writes memory the GPU may still
+// be reading. Writes go straight into mapped memory, with no staging copy or implicit sync. If the driver
+// won't map the buffer it falls back to an ordinary buffer written with glBufferSubData.
+class StreamBuffer
+{
+public:
+	StreamBuffer(size_t regionSize_);
+	~StreamBuffer();
+	void Bind(GLenum target = GL_ARRAY_BUFFER) const;
+
+	// Moves to the next region, waiting until the GPU is done with it
+	void BeginFrame();
+	// Fences the current region, call after the frame's last draw using it
+	void EndFrame();
+
+	// Copies data into the current region and returns its byte offset in the buffer. A frame outgrowing
+	// its region stalls until the GPU is idle and reallocates larger, setting reallocated so attribute
+	// bindings can be redone.
+	size_t Write(const void* data, size_t size, size_t alignment, bool* reallocated = nullptr);
+
+private:
+	static constexpr int regionNum = 3;
+	static constexpr size_t regionAlignment = 256;
+
+	unsigned int dataID = 0;
+	char* mapped = nullptr; // Null when writes go through glBufferSubData
+	size_t regionSize;
+	int region = 0;
+	size_t regionUsed = 0;
+	std::array<GLsync, regionNum> fences{};
+
+	void Create();
+	void Destroy();
+	static void Wait(GLsync& fence);
+};
\ No newline at end of file
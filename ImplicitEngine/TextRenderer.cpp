@@ -1,5 +1,10 @@
 #include "TextRenderer.h"
 
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
 TextRenderer::TextRenderer()
 {
 	if (FT_Init_FreeType(&ft))
@@ -19,27 +24,36 @@ TextRenderer::TextRenderer()
     // Enable blending
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (const char* dir = std::getenv("IMPLICIT_ENGINE_FONT_DIR"))
+        AddFontDirectory(dir);
 }
 
 TextRenderer::~TextRenderer()
 {
 	FT_Done_FreeType(ft);
 
+    for (auto& [meta, font] : fonts)
+        glDeleteTextures(1, &font.atlasID);
+
     delete textVB;
     delete textVA;
     delete textVBL;
     delete textShader;
 }
 
-void TextRenderer::LoadFont(std::string_view path, std::string_view name, unsigned int size)
+bool TextRenderer::LoadFont(std::string_view path, std::string_view name, unsigned int size)
 {
+    static constexpr int atlasW = 1024;
+    static constexpr int padding = 1; // Keeps linear filtering from bleeding neighbouring glyphs in
+
 	FT_Face face;
 
     // Load font into face
-    if (FT_New_Face(ft, path.data(), 0, &face))
+    if (FT_New_Face(ft, std::string(path).c_str(), 0, &face))
     {
         std::cerr << "Failed to load font: " << path << '\n';
-        return;
+        return false;
     }
 
     // Add font to fonts map
@@ -48,11 +62,10 @@ void TextRenderer::LoadFont(std::string_view path, std::string_view name, unsign
 	// Set font size
 	FT_Set_Pixel_Sizes(face, 0, size);
 
-    // Disable byte-alignment restriction
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-	// Load all characters
-    for (unsigned char c = 0; c <= 128; c++)
+    // Render every glyph into a shelf packed atlas, rows grow downwards as they fill
+    std::vector<unsigned char> atlas;
+    int penX = padding, penY = padding, rowH = 0;
+    for (unsigned char c = 0; c < 128; c++)
     {
         // Load character glyph 
         if (FT_Load_Char(face, c, FT_LOAD_RENDER))
@@ -61,62 +74,165 @@ void TextRenderer::LoadFont(std::string_view path, std::string_view name, unsign
             continue;
         }
 
-        // Generate texture
-        unsigned int texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-
-        // Set texture options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // Now store character for later use
+        const FT_Bitmap& bitmap = face->glyph->bitmap;
+        int gw = (int)bitmap.width, gh = (int)bitmap.rows;
+        if (penX + gw + padding > atlasW)
+        {
+            penX = padding;
+            penY += rowH + padding;
+            rowH = 0;
+        }
+
+        atlas.resize((size_t)atlasW * (penY + gh + padding));
+        for (int row = 0; row < gh; row++)
+            std::copy_n(bitmap.buffer + row * bitmap.pitch, gw, atlas.begin() + (size_t)(penY + row) * atlasW + penX);
+
+        // Texture coordinates are normalized once the atlas height is known
         Character character = {
-            texture,
-            face->glyph->bitmap.width, face->glyph->bitmap.rows,
+            (float)penX, (float)penY, (float)(penX + gw), (float)(penY + gh),
+            gw, gh,
             face->glyph->bitmap_left, face->glyph->bitmap_top,
             face->glyph->advance.x
         };
-
         font.chars.insert(std::pair<char, Character>(c, character));
+
+        penX += gw + padding;
+        rowH = std::max(rowH, gh);
+    }
+
+    int atlasH = penY + rowH + padding;
+    atlas.resize((size_t)atlasW * atlasH);
+    for (auto& [c, ch] : font.chars)
+    {
+        ch.u0 /= atlasW; ch.u1 /= atlasW;
+        ch.v0 /= atlasH; ch.v1 /= atlasH;
     }
 
+    // Disable byte-alignment restriction
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Upload the atlas in one go
+    glGenTextures(1, &font.atlasID);
+    glBindTexture(GL_TEXTURE_2D, font.atlasID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, atlasW, atlasH, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+
+    // Set texture options
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
     // Reset texture bind
     glBindTexture(GL_TEXTURE_2D, 0);
 
     // Free face obj
 	FT_Done_Face(face);
+    return true;
 }
 
-void TextRenderer::RenderText(std::string_view text, FontMeta font_, int screenW, int screenH, float x, float y, float scale)
+void TextRenderer::AddFontDirectory(std::string_view dir)
 {
-    // Bind shader
-    textShader->Bind();
+    fontDirs.emplace_back(dir);
+    failedFonts.clear();
+}
 
-    glUniform3f(textShader->GetUniformLocation("textColor"), 0.0f, 0.0f, 0.0f);
-    glActiveTexture(GL_TEXTURE0);
-    textVA->Bind();
+void TextRenderer::SetFontFile(std::string_view name, std::string_view path)
+{
+    fontFiles[std::string(name)] = path;
+    failedFonts.clear();
+}
 
-    if (!fonts.contains(font_))
-        LoadFont("C:\\Windows\\Fonts\\" + font_.name + ".ttf", font_.name, font_.size);
+std::vector<std::string> TextRenderer::FindFonts(std::string_view name)
+{
+    // Fonts metrically close to Arial, for systems without it
+    static constexpr const char* fallbackNames[] = { "Arial", "LiberationSans-Regular", "DejaVuSans", "FreeSans", "Helvetica" };
+
+    std::vector<std::string> paths;
+    auto add = [&](std::optional<std::string> path)
+        {
+            if (path.has_value() && std::find(paths.begin(), paths.end(), path.value()) == paths.end())
+                paths.push_back(std::move(path.value()));
+        };
+
+    auto file = fontFiles.find(std::string(name));
+    if (file != fontFiles.end()) add(file->second);
 
-    if (!fonts.contains(font_))
+    add(SearchFontDirs(name));
+    for (const char* fallback : fallbackNames)
+        add(SearchFontDirs(fallback));
+
+    return paths;
+}
+
+std::optional<std::string> TextRenderer::SearchFontDirs(std::string_view name)
+{
+    std::vector<std::filesystem::path> dirs(fontDirs.begin(), fontDirs.end());
+
+    // Platform font directories
+#ifdef _WIN32
+    const char* windir = std::getenv("WINDIR");
+    dirs.push_back(std::filesystem::path(windir ? windir : "C:\\Windows") / "Fonts");
+#elif defined(__APPLE__)
+    dirs.push_back("/Library/Fonts");
+    dirs.push_back("/System/Library/Fonts");
+#else
+    if (const char* home = std::getenv("HOME"))
+    {
+        dirs.push_back(std::filesystem::path(home) / ".local/share/fonts");
+        dirs.push_back(std::filesystem::path(home) / ".fonts");
+    }
+    dirs.push_back("/usr/local/share/fonts");
+    dirs.push_back("/usr/share/fonts");
+#endif
+
+    auto lower = [](std::string str)
+        {
+            std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+            return str;
+        };
+    std::string target = lower(std::string(name));
+
+    std::error_code err;
+    for (const std::filesystem::path& dir : dirs)
+    {
+        if (!std::filesystem::is_directory(dir, err)) continue;
+
+        for (auto it = std::filesystem::recursive_directory_iterator(dir, std::filesystem::directory_options::skip_permission_denied, err);
+            it != std::filesystem::recursive_directory_iterator(); it.increment(err))
+        {
+            if (err) break;
+            if (!it->is_regular_file(err)) continue;
+
+            std::string ext = lower(it->path().extension().string());
+            if ((ext == ".ttf" || ext == ".otf") && lower(it->path().stem().string()) == target)
+                return it->path().string();
+        }
+    }
+
+    return {};
+}
+
+void TextRenderer::QueueText(std::string_view text, FontMeta font_, int screenW, int screenH, float x, float y, float scale)
+{
+    if (!fonts.contains(font_) && !failedFonts.contains(font_))
+    {
+        // A file FreeType can't open shouldn't cost us text while other candidates remain
+        std::vector<std::string> paths = FindFonts(font_.name);
+        for (const std::string& path : paths)
+            if (LoadFont(path, font_.name, font_.size)) break;
+
+        if (paths.empty())
+            std::cerr << "Failed to find font: " << font_.name << '\n';
+
+        if (!fonts.contains(font_))
+            failedFonts.insert(font_);
+    }
+
+    auto fontIt = fonts.find(font_);
+    if (fontIt == fonts.end())
         return;
 
-    Font& font = fonts[font_];
+    Font& font = fontIt->second;
 
     // Convert x and y into OpenGL coordinates
     x = (x / screenW) * 2 - 1;
@@ -125,37 +241,62 @@ void TextRenderer::RenderText(std::string_view text, FontMeta font_, int screenW
     // iterate through all characters
     for (char c : text)
     {
-        Character ch = font.chars[c];
+        auto charIt = font.chars.find(c);
+        if (charIt == font.chars.end()) continue;
+        const Character& ch = charIt->second;
 
         float xpos = x + (ch.bx * scale) / screenW;
         float ypos = y - ((ch.h - ch.by) * scale) / screenH;
 
         float w = ch.w * scale / screenW;
         float h = ch.h * scale / screenH;
-        // update VBO for each character
+
         float vertices[6][4] = {
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos,     ypos,       0.0f, 1.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
+            { xpos,     ypos + h,   ch.u0, ch.v0 },
+            { xpos,     ypos,       ch.u0, ch.v1 },
+            { xpos + w, ypos,       ch.u1, ch.v1 },
 
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
-            { xpos + w, ypos + h,   1.0f, 0.0f }
+            { xpos,     ypos + h,   ch.u0, ch.v0 },
+            { xpos + w, ypos,       ch.u1, ch.v1 },
+            { xpos + w, ypos + h,   ch.u1, ch.v0 }
         };
-        // Render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.texID);
-        // Update contents of VB
-        textVB->SetData(vertices, sizeof(vertices));
+        font.queued.insert(font.queued.end(), &vertices[0][0], &vertices[0][0] + 24);
 
-        // Render quad
-        glDrawArrays(GL_TRIANGLES, 0, 6);
         // Advance cursors for next glyph
         x += (ch.advance >> 6) * scale / screenW;
     }
+}
+
+void TextRenderer::DrawQueued()
+{
+    // Bind shader
+    textShader->Bind();
+
+    glUniform3f(textShader->GetUniformLocation("textColor"), 0.0f, 0.0f, 0.0f);
+    glActiveTexture(GL_TEXTURE0);
+    textVA->Bind();
+
+    for (auto& [meta, font] : fonts)
+    {
+        if (font.queued.empty()) continue;
+
+        glBindTexture(GL_TEXTURE_2D, font.atlasID);
+        textVB->SetData(font.queued.data(), font.queued.size() * sizeof(float));
+        glDrawArrays(GL_TRIANGLES, 0, (int)font.queued.size() / 4);
+
+        font.queued.clear();
+    }
+
     textVA->Unbind();
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void TextRenderer::RenderText(std::string_view text, FontMeta font_, int screenW, int screenH, float x, float y, float scale)
+{
+    QueueText(text, font_, screenW, screenH, x, y, scale);
+    DrawQueued();
+}
+
 size_t FontMetaHasher::operator()(const FontMeta& obj) const
 {
     size_t h1 = std::hash<std::string>{}(obj.name);
@@ -5,7 +5,10 @@
 #include FT_FREETYPE_H
 
 #include <string>
+#include <vector>
 #include <unordered_map>
+#include <unordered_set>
+#include <optional>
 
 #include "Shader.h"
 #include "VertexBuffer.h"
@@ -14,7 +17,7 @@
 
 struct Character
 {
-	unsigned int texID;
+	float u0, v0, u1, v1; // Glyph rectangle in the font's atlas
 	int64_t w, h, bx, by, advance;
 };
 
@@ -25,9 +28,12 @@ struct FontMeta
 	unsigned int size;
 };
 
+// Every glyph of a font packed into one texture so a whole frame of text is one draw
 struct Font
 {
 	std::unordered_map<char, Character> chars;
+	unsigned int atlasID = 0;
+	std::vector<float> queued; // Quads waiting for DrawQueued, as <vec2 pos, vec2 tex>
 };
 
 struct FontMetaHasher
@@ -41,7 +47,23 @@ public:
 	TextRenderer();
 	~TextRenderer();
 
-	void LoadFont(std::string_view path, std::string_view name, unsigned int size);
+	// False if FreeType can't open the file
+	bool LoadFont(std::string_view path, std::string_view name, unsigned int size);
+
+	// Fonts are looked up by file name in these directories, searched recursively before a fixed list
+	// of platform font directories: %WINDIR%\Fonts on Windows, /Library/Fonts and /System/Library/Fonts
+	// on macOS, and ~/.local/share/fonts, ~/.fonts, /usr/local/share/fonts and /usr/share/fonts elsewhere.
+	// fontconfig isn't consulted. The IMPLICIT_ENGINE_FONT_DIR environment variable adds one at startup.
+	void AddFontDirectory(std::string_view dir);
+	// Maps a font name straight to a file, skipping the search
+	void SetFontFile(std::string_view name, std::string_view path);
+	// Font files to try for name in order, the named font first and then common fallback fonts
+	std::vector<std::string> FindFonts(std::string_view name);
+
+	// Adds text to the batch for its font, nothing is drawn until DrawQueued
+	void QueueText(std::string_view text, FontMeta font_, int screenW, int screenH, float x, float y, float scale);
+	// Draws all queued text, one draw call per font
+	void DrawQueued();
 
 	void RenderText(std::string_view text, FontMeta font_, int screenW, int screenH, float x, float y, float scale);
 
@@ -54,4 +76,10 @@ protected:
 	Shader* textShader;
 
 	std::unordered_map<FontMeta, Font, FontMetaHasher> fonts;
+	std::unordered_set<FontMeta, FontMetaHasher> failedFonts; // Not retried every frame
+
+	std::vector<std::string> fontDirs;
+	std::unordered_map<std::string, std::string> fontFiles;
+
+	std::optional<std::string> SearchFontDirs(std::string_view name);
 };
\ No newline at end of file
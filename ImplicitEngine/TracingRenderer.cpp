@@ -0,0 +1,399 @@
+#include "TracingRenderer.h"
+
+TracingRenderer::TracingRenderer(CallbackFun refreshFun, int seedNum_, int finalMeshRes_, int threadNum)
+	: Renderer(refreshFun), pool(threadNum), seedNum(seedNum_),
+		finalMeshRes(finalMeshRes_), frameMeshRes(finalMeshRes_), seeds(pool.get_thread_count()), coverage(finalMeshRes) {}
+
+TracingRenderer::~TracingRenderer()
+{
+	pool.wait_for_tasks();
+}
+
+int TracingRenderer::GetSeedNum()
+{
+	return seedNum;
+}
+
+int TracingRenderer::GetFinalMeshRes()
+{
+	return finalMeshRes;
+}
+
+void TracingRenderer::SetSeedNum(int value)
+{
+	seedNum = value;
+	UpdateJobs();
+}
+
+void TracingRenderer::SetFinalMeshRes(int value)
+{
+	finalMeshRes = value;
+	UpdateJobs();
+}
+
+void TracingRenderer::KeepSeeds(bool keep)
+{
+	keepSeeds = keep;
+	if (!keepSeeds)
+	{
+		std::lock_guard lock(displayMutex);
+		jobSeeds.clear();
+	}
+	UpdateJobs();
+}
+
+std::optional<std::shared_ptr<Seeds>> TracingRenderer::GetSeeds(size_t id)
+{
+	std::lock_guard lock(displayMutex);
+	if (jobSeeds.contains(id))
+		return jobSeeds[id];
+	else
+		return {};
+}
+
+void TracingRenderer::CountCachedMemory(size_t id, MemoryUsage* usage)
+{
+	std::lock_guard lock(displayMutex);
+	if (!jobSeeds.contains(id)) return;
+
+	const Seeds& kept = *jobSeeds[id];
+	usage->seeds = kept.capacity() * sizeof(std::vector<Seed>);
+	for (const auto& lane : kept)
+		usage->seeds += lane.capacity() * sizeof(Seed);
+}
+
+void TracingRenderer::EvictCaches()
+{
+	std::lock_guard lock(displayMutex);
+	jobSeeds.clear();
+}
+
+void TracingRenderer::ForgetJob(size_t id)
+{
+	std::lock_guard lock(displayMutex);
+	jobSeeds.erase(id);
+}
+
+int TracingRenderer::MaxResolutionDrop()
+{
+	return std::clamp(finalMeshRes - 1, 0, maxResolutionDrop);
+}
+
+void TracingRenderer::ProcessJob(Job* job)
+{
+	int threadNum = pool.get_thread_count();
+	job->funcs.Resize(threadNum);
+
+	Bounds bounds = job->bounds;
+	frameMeshRes = std::max(finalMeshRes - job->resolutionDrop, 1);
+	cellSize = std::min(bounds.w(), bounds.h()) / Pow2(frameMeshRes);
+
+	job->timings = {};
+	job->funcs.ResetEvalCounts();
+	ZONE(frame, &events, job->id);
+
+	// ===== Seed Generation =====
+	STAGE_ZONE(seeding, &events, job->id, &job->timings);
+	int laneNum = deterministic ? deterministicLanes : threadNum;
+	seeds.resize(laneNum);
+	for (auto& vec : seeds)
+		vec.clear();
+
+	std::vector<uint32_t> rngSeeds(laneNum);
+	for (int li = 0; li < laneNum; li++)
+		rngSeeds[li] = deterministic ? ProximalBracketingGenerator::LaneSeed(deterministicSeed, li) : rd();
+
+	int seedsPerLane = seedNum / laneNum;
+	std::vector<std::future<void>> futs;
+	for (int ti = 0; ti < std::min(threadNum, laneNum); ti++)
+	{
+		futs.push_back(pool.submit([=, this, &rngSeeds]()
+			{
+				ZONE(seed_lanes, &events, job->id);
+				for (int li = ti; li < laneNum; li += threadNum)
+					ProximalBracketingGenerator::Generate(&seeds[li], job->funcs[ti], bounds, 16, frameMeshRes, seedsPerLane, rngSeeds[li]);
+			}));
+	}
+
+	for (auto& fut : futs)
+		fut.wait();
+
+	if (keepSeeds)
+	{
+		auto snapshot = std::make_shared<Seeds>(seeds);
+		std::lock_guard lock(displayMutex);
+		jobSeeds[job->id].swap(snapshot);
+	}
+	END_ZONE(seeding);
+
+	// ===== Tracing =====
+	// Squares already crossed by a traced curve, seeds inside them are not traced again
+	STAGE_ZONE(mesh, &events, job->id, &job->timings);
+	coverage.Reset(frameMeshRes);
+	coverage.bounds = bounds;
+	END_ZONE(mesh);
+
+	STAGE_ZONE(contour, &events, job->id, &job->timings);
+
+	std::vector<std::vector<double>> laneOutputs(laneNum);
+	std::vector<std::vector<TracedLine>> laneLines(laneNum);
+	futs.clear();
+	if (deterministic)
+	{
+		// Which seeds get skipped depends on tracing order, so trace everything in lane order
+		futs.push_back(pool.submit([=, this, &laneOutputs, &laneLines]()
+			{
+				ZONE(trace_lanes, &events, job->id);
+				for (int li = 0; li < laneNum; li++)
+					TraceSeeds(&laneOutputs[li], &laneLines[li], job->funcs[0], &seeds[li], bounds, &coverage);
+			}));
+	}
+	else
+	{
+		for (int ti = 0; ti < threadNum; ti++)
+		{
+			futs.push_back(pool.submit([=, this, &laneOutputs, &laneLines]()
+				{
+					ZONE(trace_lanes, &events, job->id);
+					TraceSeeds(&laneOutputs[ti], &laneLines[ti], job->funcs[ti], &seeds[ti], bounds, &coverage);
+				}));
+		}
+	}
+
+	for (auto& fut : futs)
+		fut.wait();
+	END_ZONE(contour);
+
+	// Collect polylines into a single vector
+	STAGE_ZONE(collect, &events, job->id, &job->timings);
+	// Concurrent lanes can trace the same curve from seeds in different squares, each starting before the
+	// other's coverage got there. Coverage is replayed in lane order, dropping polylines whose seed square
+	// an earlier polyline crossed, which is the rule deterministic mode applies while tracing.
+	if (!deterministic)
+		coverage.Reset(frameMeshRes);
+
+	// Traced points are world coordinates, offset them from the origin before narrowing
+	job->ResetVerts(bounds);
+	for (int li = 0; li < laneNum; li++)
+	{
+		const std::vector<double>& vec = laneOutputs[li];
+		for (const TracedLine& line : laneLines[li])
+		{
+			if (!deterministic)
+			{
+				if (Covered(coverage, line.seed)) continue;
+				for (size_t i = line.first; i < line.end; i += 4)
+					Cover(&coverage, { vec[i], vec[i + 1] }, { vec[i + 2], vec[i + 3] });
+			}
+
+			for (size_t i = line.first; i < line.end; i += 2)
+			{
+				job->verts.push_back((float)(vec[i] - job->xOrigin));
+				job->verts.push_back((float)(vec[i + 1] - job->yOrigin));
+			}
+		}
+	}
+
+	job->memory.transient = 0;
+	for (const auto& vec : laneOutputs) job->memory.transient += vec.capacity() * sizeof(double);
+	for (const auto& vec : laneLines) job->memory.transient += vec.capacity() * sizeof(TracedLine);
+
+	// Tracing never samples the grid, so there is no filtered fraction
+	job->evals = job->funcs.GetEvalCounts();
+}
+
+void TracingRenderer::TraceSeeds(std::vector<double>* lineVerts, std::vector<TracedLine>* lines, Function* funcPtr, const std::vector<Seed>* laneSeeds, const Bounds& bounds, Mesh* coverage) const
+{
+	Function& func = *funcPtr;
+	func.SetEvalStage(EvalStage::TRACING);
+	double tol = cellSize * 1e-3;
+
+	std::vector<TracePoint> forward, backward;
+	for (const Seed& s : *laneSeeds)
+	{
+		TracePoint start = { s.x, s.y };
+		if (!bounds.In(start.x, start.y)) continue;
+		if (Covered(*coverage, start)) continue;
+
+		// Pull the seed onto the curve, then claim its square so no other lane traces from there too
+		if (!Correct(start, func, tol)) continue;
+		if (!bounds.In(start.x, start.y) || !Claim(*coverage, start)) continue;
+
+		// Trace away from the seed in both directions, unless the curve closes on itself
+		forward.clear();
+		backward.clear();
+		bool closed = TraceDirection(&forward, funcPtr, start, 1.0, bounds, coverage);
+		if (!closed)
+			TraceDirection(&backward, funcPtr, start, -1.0, bounds, coverage);
+
+		// Join into a single polyline, ordered from the end of the backward trace to the end of the forward trace
+		std::vector<TracePoint> polyline(backward.rbegin(), backward.rend());
+		size_t first = lineVerts->size();
+		polyline.push_back(start);
+		polyline.insert(polyline.end(), forward.begin(), forward.end());
+
+		for (size_t i = 1; i < polyline.size(); i++)
+		{
+			lineVerts->push_back(polyline[i - 1].x);
+			lineVerts->push_back(polyline[i - 1].y);
+			lineVerts->push_back(polyline[i].x);
+			lineVerts->push_back(polyline[i].y);
+		}
+		lines->push_back({ first, lineVerts->size(), start });
+	}
+}
+
+bool TracingRenderer::TraceDirection(std::vector<TracePoint>* points, Function* funcPtr, TracePoint start, double dir, const Bounds& bounds, Mesh* coverage) const
+{
+	// Parameters
+	static constexpr double maxStepCells = 2.0; // Longest step, in squares of the final mesh
+	static constexpr double minStepCells = 1.0 / 256; // Shortest step before giving up on a singular point
+	static constexpr double maxTurn = 0.2; // Largest change in tangent direction (radians) accepted for a step
+	static constexpr double easyTurn = 0.05; // Steps turning less than this grow the step length
+	static constexpr double growth = 1.5;
+	static constexpr int maxStepsPerCell = 8; // Step limit, relative to the final mesh dimension
+
+	Function& func = *funcPtr;
+	Bounds exBounds = bounds.Expand(BOUNDS_EXPANSION);
+
+	double maxStep = cellSize * maxStepCells;
+	double minStep = cellSize * minStepCells;
+	double tol = cellSize * 1e-3;
+	int64_t maxSteps = Pow2(frameMeshRes) * maxStepsPerCell;
+
+	double gx, gy;
+	if (!Gradient(func, start, gx, gy)) return false;
+
+	TracePoint p = start;
+	double gLen = sqrt(gx * gx + gy * gy);
+	double tx = -gy / gLen * dir, ty = gx / gLen * dir; // Unit tangent
+	double step = cellSize;
+	double travelled = 0.0;
+
+	for (int64_t si = 0; si < maxSteps; si++)
+	{
+		// Predictor, then corrector back onto the curve
+		TracePoint q = { p.x + tx * step, p.y + ty * step };
+		double qgx, qgy;
+		bool ok = Correct(q, func, tol) && Gradient(func, q, qgx, qgy);
+
+		// Tangent at the new point, kept pointing the same way as the old one
+		double qtx = 0.0, qty = 0.0;
+		if (ok)
+		{
+			double qgLen = sqrt(qgx * qgx + qgy * qgy);
+			qtx = -qgy / qgLen; qty = qgx / qgLen;
+			if (qtx * tx + qty * ty < 0) { qtx = -qtx; qty = -qty; }
+		}
+
+		double turn = ok ? acos(std::clamp(qtx * tx + qty * ty, -1.0, 1.0)) : DBL_MAX;
+		if (!ok || turn > maxTurn)
+		{
+			// Too much curvature for this step length
+			step /= 2;
+			if (step < minStep) return false;
+			continue;
+		}
+
+		Cover(coverage, p, q);
+		points->push_back(q);
+		travelled += step;
+
+		// Loop closure
+		double dsx = q.x - start.x, dsy = q.y - start.y;
+		if (travelled > 3 * step && dsx * dsx + dsy * dsy < step * step)
+		{
+			points->push_back(start);
+			return true;
+		}
+
+		// Left the region of interest
+		if (!exBounds.In(q.x, q.y)) return false;
+
+		p = q;
+		tx = qtx; ty = qty;
+		if (turn < easyTurn) step = std::min(step * growth, maxStep);
+	}
+	return false;
+}
+
+bool TracingRenderer::Correct(TracePoint& p, Function& func, double tol) const
+{
+	static constexpr int maxNewtIter = 6;
+
+	for (int ni = 0; ni < maxNewtIter; ni++)
+	{
+		double fp = func(p.x, p.y);
+		double gx, gy;
+		if (!std::isfinite(fp) || !Gradient(func, p, gx, gy)) return false;
+
+		// Newton step along the gradient
+		double gSq = gx * gx + gy * gy;
+		p.x -= fp * gx / gSq;
+		p.y -= fp * gy / gSq;
+
+		if (abs(fp) / sqrt(gSq) < tol) return true;
+	}
+	return false;
+}
+
+bool TracingRenderer::Gradient(Function& func, TracePoint p, double& gx, double& gy) const
+{
+	// Central differences, with a step kept well above the precision of the coordinates
+	double h = std::max(cellSize * 1e-3, (abs(p.x) + abs(p.y)) * 1e-10);
+	gx = (func(p.x + h, p.y) - func(p.x - h, p.y)) / (2 * h);
+	gy = (func(p.x, p.y + h) - func(p.x, p.y - h)) / (2 * h);
+
+	double gSq = gx * gx + gy * gy;
+	return gSq > 0.0 && std::isfinite(gSq);
+}
+
+void TracingRenderer::Cover(Mesh* coverage, TracePoint a, TracePoint b) const
+{
+	// Parameters
+	static constexpr double sampleCells = 1.0 / 8; // Sample spacing along the segment, in squares
+	static constexpr double marginCells = 1.0 / 8; // Squares this close to a sample are covered too, absorbs the chord's sag off the curve
+
+	// Sample the segment finely enough that no square it crosses is missed
+	const Bounds& bounds = coverage->bounds;
+	double len = sqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+	int samples = (int)ceil(len / (cellSize * sampleCells)) + 1;
+	int last = coverage->dim - 1;
+
+	for (int i = 0; i <= samples; i++)
+	{
+		double t = (double)i / samples;
+		double x = a.x + (b.x - a.x) * t;
+		double y = a.y + (b.y - a.y) * t;
+		if (!bounds.In(x, y)) continue;
+
+		double cx = (x - bounds.xmin) / bounds.w() * coverage->dim;
+		double cy = (y - bounds.ymin) / bounds.h() * coverage->dim;
+		for (int by = std::max((int)(cy - marginCells), 0); by <= std::min((int)(cy + marginCells), last); by++)
+			for (int bx = std::max((int)(cx - marginCells), 0); bx <= std::min((int)(cx + marginCells), last); bx++)
+				coverage->Set(bx, by);
+	}
+}
+
+bool TracingRenderer::Covered(Mesh& coverage, TracePoint p) const
+{
+	int bx, by;
+	CoverageBox(coverage, p, &bx, &by);
+
+	// Only the seed's own square counts, a curve traced through a neighbouring square may be a separate component
+	return coverage.GetConcurrent(bx, by);
+}
+
+bool TracingRenderer::Claim(Mesh& coverage, TracePoint p) const
+{
+	int bx, by;
+	CoverageBox(coverage, p, &bx, &by);
+	return !coverage.TrySet(bx, by);
+}
+
+void TracingRenderer::CoverageBox(const Mesh& coverage, TracePoint p, int* bx, int* by) const
+{
+	const Bounds& bounds = coverage.bounds;
+	*bx = std::min((int)((p.x - bounds.xmin) / bounds.w() * coverage.dim), coverage.dim - 1);
+	*by = std::min((int)((p.y - bounds.ymin) / bounds.h() * coverage.dim), coverage.dim - 1);
+}
\ No newline at end of file
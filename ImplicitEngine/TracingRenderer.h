@@ -0,0 +1,71 @@
+#pragma once
+#include "FilteringRenderer.h"
+
+struct TracePoint { double x, y; };
+
+// A lane's traced polyline, its segments are [first, end) in the lane's output
+struct TracedLine
+{
+	size_t first, end;
+	TracePoint seed;
+};
+
+class TracingRenderer : public Renderer
+{
+public:
+	TracingRenderer(CallbackFun refreshFun, int seedNum_ = 2048, int finalMeshRes_ = 9, int threadNum = DefaultThreadNum());
+
+	~TracingRenderer();
+
+	int GetSeedNum();
+	int GetFinalMeshRes();
+
+	void SetSeedNum(int value);
+	void SetFinalMeshRes(int value);
+
+	void KeepSeeds(bool keep);
+	std::optional<std::shared_ptr<Seeds>> GetSeeds(size_t id);
+
+	// For parity with filtering renderer
+	void KeepMesh(bool) {}
+	void AdaptSeedNum(bool) {}
+	int GetFilterMeshRes() { return 0; };
+	void SetFilterMeshRes(int) {};
+	std::optional<std::shared_ptr<Mesh>> GetMesh(size_t) { return {}; };
+	std::optional<SeedStats> GetSeedStats(size_t) { return {}; };
+
+protected:
+	void ProcessJob(Job* job);
+	void CountCachedMemory(size_t id, MemoryUsage* usage);
+	void EvictCaches();
+	void ForgetJob(size_t id);
+	int MaxResolutionDrop();
+	void TraceSeeds(std::vector<double>* lineVerts, std::vector<TracedLine>* lines, Function* funcPtr, const std::vector<Seed>* laneSeeds, const Bounds& bounds, Mesh* coverage) const;
+	bool TraceDirection(std::vector<TracePoint>* points, Function* funcPtr, TracePoint start, double dir, const Bounds& bounds, Mesh* coverage) const;
+	bool Correct(TracePoint& p, Function& func, double tol) const;
+	bool Gradient(Function& func, TracePoint p, double& gx, double& gy) const;
+	void Cover(Mesh* coverage, TracePoint a, TracePoint b) const;
+	bool Covered(Mesh& coverage, TracePoint p) const;
+	bool Claim(Mesh& coverage, TracePoint p) const;
+	void CoverageBox(const Mesh& coverage, TracePoint p, int* bx, int* by) const;
+
+	ThreadPool pool;
+	std::random_device rd;
+
+	int seedNum;
+	int finalMeshRes;
+	int frameMeshRes; // Final mesh resolution of the frame being rendered, lowered under a memory budget
+	double cellSize = 0.0; // World size of one square at the final mesh resolution
+
+	Seeds seeds;
+	Mesh coverage;
+
+	// Snapshots for display, each frame publishes new ones so a reader's copy is never written to.
+	// The map is guarded by displayMutex.
+	std::mutex displayMutex;
+	bool keepSeeds = false;
+	std::map<size_t, std::shared_ptr<Seeds>> jobSeeds;
+
+	// Number of seed lanes used in deterministic mode, matching the filtering renderer
+	static constexpr int deterministicLanes = 16;
+};
\ No newline at end of file
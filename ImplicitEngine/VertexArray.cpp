@@ -23,6 +23,18 @@ void VertexArray::AddVBuffer(const VertexBuffer& vb, const VertexBufferLayout& v
 {
 	Bind();
 	vb.Bind();
+	SetLayout(vbLayout);
+}
+
+void VertexArray::AddVBuffer(const StreamBuffer& sb, const VertexBufferLayout& vbLayout)
+{
+	Bind();
+	sb.Bind();
+	SetLayout(vbLayout);
+}
+
+void VertexArray::SetLayout(const VertexBufferLayout& vbLayout)
+{
 	const auto& layoutElements = vbLayout.GetElements();
 	char* offset = (char*)0;
 	for (size_t i = 0; i < layoutElements.size(); i++)
@@ -1,6 +1,7 @@
 #pragma once
 #include "VertexBuffer.h"
 #include "VertexBufferLayout.h"
+#include "StreamBuffer.h"
 
 class VertexArray
 {
@@ -11,7 +12,10 @@ public:
 	void Bind() const;
 	void Unbind() const;
 	void AddVBuffer(const VertexBuffer& vb, const VertexBufferLayout& vbLayout);
+	void AddVBuffer(const StreamBuffer& sb, const VertexBufferLayout& vbLayout);
 
 private:
 	unsigned int dataID;
+
+	void SetLayout(const VertexBufferLayout& vbLayout);
 };
\ No newline at end of file
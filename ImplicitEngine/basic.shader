@@ -2,9 +2,13 @@
 #version 460 core
 layout(location = 0) in vec2 aPos;
 
+// Maps buffer coordinates to normalized device coordinates, identity for geometry already in screen space
+uniform vec2 scale;
+uniform vec2 offset;
+
 void main()
 {
-	gl_Position = vec4(aPos.x, aPos.y, 0.0, 1.0);
+	gl_Position = vec4(aPos * scale + offset, 0.0, 1.0);
 }
 
 #shader fragment
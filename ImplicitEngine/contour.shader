@@ -0,0 +1,37 @@
+#shader vertex
+#version 460 core
+layout(location = 0) in vec2 aPos;
+
+// View scale shared by every draw, as in basic.shader
+uniform vec2 scale;
+
+// One entry per contour in the multi-draw, positions are relative to the contour's origin so each has its own offset
+struct DrawData
+{
+	vec4 col;
+	vec2 offset;
+};
+
+layout(std430, binding = 0) readonly buffer Draws
+{
+	DrawData draws[];
+};
+
+flat out vec4 drawCol;
+
+void main()
+{
+	DrawData draw = draws[gl_DrawID];
+	gl_Position = vec4(aPos * scale + draw.offset, 0.0, 1.0);
+	drawCol = draw.col;
+}
+
+#shader fragment
+#version 460 core
+flat in vec4 drawCol;
+out vec4 FragColor;
+
+void main()
+{
+	FragColor = drawCol;
+}
\ No newline at end of file